@@ -0,0 +1,630 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "data.h"
+#include "game.h"
+#include "path.h"
+#include "hpa.h"
+#include "rng.h"
+#include "scan.h"
+#include "stats.h"
+
+/*
+ * Fixed-seed benchmarks of the hot paths and of whole turns. Every
+ * benchmark is run BENCH_ROUNDS times and the fastest round is reported,
+ * along with the heap allocations and frees it made per operation. The results can
+ * be written out and compared against a baseline written the same way,
+ * failing when a benchmark got slower than the tolerance allows or
+ * allocates more than before.
+ */
+
+#define BENCH_SEED 0x5eed
+#define BENCH_ROUNDS 5
+#define BENCH_LINES 4096
+#define BENCH_NAME_MAX 32
+#define BENCH_BASELINE_MAX 256
+
+static struct {
+    const char *variant;
+    const char *baseline;
+    const char *output;
+    double tolerance;
+} options;
+
+static struct {
+    char variant[BENCH_NAME_MAX];
+    char name[BENCH_NAME_MAX];
+    double ns;
+    double allocs, frees;
+} baseline[BENCH_BASELINE_MAX];
+static int baseline_count;
+
+static FILE *output;
+static int regressions;
+
+/*
+ * Allocation counting.
+ * ====================
+ *
+ * The Makefile links the benchmarks with every function of the allocator
+ * family wrapped (ld --wrap), so the calls made by the engine and the
+ * benchmarks land here and are counted before being passed on. Calls made
+ * inside the C library itself are not counted.
+ */
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+void *__real_reallocarray(void *pointer, size_t count, size_t size);
+void *__real_aligned_alloc(size_t alignment, size_t size);
+int __real_posix_memalign(void **pointer, size_t alignment, size_t size);
+void *__real_memalign(size_t alignment, size_t size);
+char *__real_strdup(const char *string);
+void __real_free(void *pointer);
+
+static unsigned long bench_allocs;
+static unsigned long bench_frees;
+
+#define BENCH_COUNT(MACRO_counter)\
+    __atomic_fetch_add(&(MACRO_counter), 1, __ATOMIC_RELAXED)
+
+void *__wrap_malloc(size_t size)
+{
+    BENCH_COUNT(bench_allocs);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    BENCH_COUNT(bench_allocs);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size)
+{
+    BENCH_COUNT(bench_allocs);
+    return __real_realloc(pointer, size);
+}
+
+void *__wrap_reallocarray(void *pointer, size_t count, size_t size)
+{
+    BENCH_COUNT(bench_allocs);
+    return __real_reallocarray(pointer, count, size);
+}
+
+void *__wrap_aligned_alloc(size_t alignment, size_t size)
+{
+    BENCH_COUNT(bench_allocs);
+    return __real_aligned_alloc(alignment, size);
+}
+
+int __wrap_posix_memalign(void **pointer, size_t alignment, size_t size)
+{
+    BENCH_COUNT(bench_allocs);
+    return __real_posix_memalign(pointer, alignment, size);
+}
+
+void *__wrap_memalign(size_t alignment, size_t size)
+{
+    BENCH_COUNT(bench_allocs);
+    return __real_memalign(alignment, size);
+}
+
+char *__wrap_strdup(const char *string)
+{
+    BENCH_COUNT(bench_allocs);
+    return __real_strdup(string);
+}
+
+void __wrap_free(void *pointer)
+{
+    if (pointer != NULL) {
+        BENCH_COUNT(bench_frees);
+    }
+    __real_free(pointer);
+}
+
+#undef BENCH_COUNT
+
+/*
+ * Measuring.
+ * ==========
+ */
+
+/** @brief Performs ops operations of a benchmark. */
+typedef void (*bench_func)(void *context, long ops);
+
+/* A missing baseline is an error rather than nothing to compare with,
+ * so a lost baseline file cannot silently turn off the checks. */
+static bool bench_baseline_LOAD(const char *path)
+{
+    FILE *file;
+
+    if ((file = fopen(path, "r")) == NULL) {
+        fprintf(stderr, "ERROR: No baseline in %s, record one first.\n",
+                path);
+        return false;
+    }
+    while (baseline_count < BENCH_BASELINE_MAX &&
+           fscanf(file, "%31s %31s %lf %lf %lf",
+               baseline[baseline_count].variant,
+               baseline[baseline_count].name,
+               &baseline[baseline_count].ns,
+               &baseline[baseline_count].allocs,
+               &baseline[baseline_count].frees) == 5) {
+        ++baseline_count;
+    }
+    fclose(file);
+    return true;
+}
+
+/* Prints how a result compares to the baseline of the same variant. */
+static void bench_COMPARE(const char *name, double ns, double allocs)
+{
+    double change;
+    int i;
+
+    for (i = 0; i < baseline_count; ++i) {
+        if (strcmp(baseline[i].variant, options.variant) == 0 &&
+            strcmp(baseline[i].name, name) == 0) {
+                break;
+        }
+    }
+    if (i == baseline_count) {
+        printf("\n");
+        return;
+    }
+
+    change = baseline[i].ns > 0.0 ?
+        (ns - baseline[i].ns) * 100.0 / baseline[i].ns : 0.0;
+    printf(" %+7.1f%%", change);
+    if (change > options.tolerance) {
+        printf(" SLOWER");
+        ++regressions;
+    }
+    /* Allocation counts do not vary between runs, any growth beyond the
+     * precision they are stored with is a regression. */
+    if (allocs > baseline[i].allocs + 0.0005) {
+        printf(" MORE ALLOCATIONS (%.3f)", baseline[i].allocs);
+        ++regressions;
+    }
+    printf("\n");
+}
+
+static void bench_RUN(const char *name, bench_func func, void *context, long ops)
+{
+    double ns, best = 0.0, allocs, frees;
+    unsigned long allocs_start, frees_start;
+    uint64_t start;
+    int round;
+
+    /* A warm-up round fills the caches and the lazily built state. */
+    func(context, ops / 10 + 1);
+
+    /* The time is the fastest round's, the allocations are counted over
+     * all of them, which the fixed seeds make the same on every run. */
+    allocs_start = __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED);
+    frees_start = __atomic_load_n(&bench_frees, __ATOMIC_RELAXED);
+    for (round = 0; round < BENCH_ROUNDS; ++round) {
+        start = stats_now();
+        func(context, ops);
+        ns = (double)(stats_now() - start) / ops;
+        if (round == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    allocs = (double)(__atomic_load_n(&bench_allocs, __ATOMIC_RELAXED) -
+            allocs_start) / ((double)ops * BENCH_ROUNDS);
+    frees = (double)(__atomic_load_n(&bench_frees, __ATOMIC_RELAXED) -
+            frees_start) / ((double)ops * BENCH_ROUNDS);
+
+    printf("%-4s %-24s %12.1f ns/op %9.3f allocs/op %9.3f frees/op",
+            options.variant, name, best, allocs, frees);
+    bench_COMPARE(name, best, allocs);
+    fflush(stdout);
+    if (output != NULL) {
+        fprintf(output, "%s %s %.1f %.3f %.3f\n",
+                options.variant, name, best, allocs, frees);
+    }
+}
+
+/*
+ * Maps.
+ * =====
+ */
+
+/* Generates a map of the given side with asteroids and enemies scaled to
+ * its area like the default 40x20 map. */
+static void bench_GAME(struct Game *g, int width, int height, int enemies)
+{
+    struct GameConfig config;
+    struct DataConfig data;
+    const int scale = width * height / (MAP_WIDTH * MAP_HEIGHT);
+
+    memset(&config, 0, sizeof(config));
+    config.planner = HP_FIELD;
+    game_create(g, &config, BENCH_SEED);
+
+    data_config_default(&data);
+    data.width = width;
+    data.height = height;
+    data.asteroids_min = ASTEROIDS_MIN * (scale > 0 ? scale : 1);
+    data.asteroids_max = ASTEROIDS_MAX * (scale > 0 ? scale : 1);
+    data.enemies_min = enemies;
+    data.enemies_max = enemies + 1;
+    game_init(g, &data);
+}
+
+/* Random open fields to scan between or search paths between. */
+static struct {
+    int x1[BENCH_LINES], y1[BENCH_LINES];
+    int x2[BENCH_LINES], y2[BENCH_LINES];
+} lines;
+
+static void bench_LINES(struct Data *d)
+{
+    struct Rng rng;
+    int i;
+
+    rng_seed(&rng, BENCH_SEED);
+    for (i = 0; i < BENCH_LINES; ++i) {
+        do {
+            lines.x1[i] = rng_range(&rng, 0, d->width);
+            lines.y1[i] = rng_range(&rng, 0, d->height);
+        } while (data_is_blocked(d, lines.x1[i], lines.y1[i]));
+        do {
+            lines.x2[i] = rng_range(&rng, 0, d->width);
+            lines.y2[i] = rng_range(&rng, 0, d->height);
+        } while (data_is_blocked(d, lines.x2[i], lines.y2[i]));
+    }
+}
+
+/*
+ * Scans.
+ * ======
+ */
+
+static volatile int bench_sink;
+
+static void bench_scan_generic_plot(void *context, long ops)
+{
+    long i;
+    for (i = 0; i < ops; ++i) {
+        const int k = i % BENCH_LINES;
+        bench_sink = scan_generic(lines.x1[k], lines.y1[k],
+                lines.x2[k], lines.y2[k], context, scan_plot);
+    }
+}
+
+static void bench_scan_generic_visibility(void *context, long ops)
+{
+    long i;
+    for (i = 0; i < ops; ++i) {
+        const int k = i % BENCH_LINES;
+        bench_sink = scan_generic(lines.x1[k], lines.y1[k],
+                lines.x2[k], lines.y2[k], context, scan_visibility);
+    }
+}
+
+static void bench_scan_line_plot(void *context, long ops)
+{
+    long i;
+    for (i = 0; i < ops; ++i) {
+        const int k = i % BENCH_LINES;
+        bench_sink = scan_line_plot(lines.x1[k], lines.y1[k],
+                lines.x2[k], lines.y2[k], context);
+    }
+}
+
+static void bench_scan_line_visibility(void *context, long ops)
+{
+    long i;
+    for (i = 0; i < ops; ++i) {
+        const int k = i % BENCH_LINES;
+        bench_sink = scan_line_visibility(lines.x1[k], lines.y1[k],
+                lines.x2[k], lines.y2[k], context);
+    }
+}
+
+static void bench_scans(void)
+{
+    struct Game g;
+
+    bench_GAME(&g, 256, 256, 100);
+    bench_LINES(&g.data);
+    bench_RUN("scan_generic/plot", bench_scan_generic_plot, &g.data, 200000);
+    bench_RUN("scan_generic/visibility",
+            bench_scan_generic_visibility, &g.data, 200000);
+    bench_RUN("scan_line/plot", bench_scan_line_plot, &g.data, 200000);
+    bench_RUN("scan_line/visibility",
+            bench_scan_line_visibility, &g.data, 200000);
+    game_deinit(&g);
+}
+
+/*
+ * Frames.
+ * =======
+ */
+
+static void bench_plot(void *context, long ops)
+{
+    long i;
+    for (i = 0; i < ops; ++i) {
+        game_plot(context);
+    }
+}
+
+static void bench_plots(void)
+{
+    static const struct { const char *name; int side_x, side_y; long ops; }
+    sizes[] = {
+        { "plot/40x20", 40, 20, 20000 },
+        { "plot/256x256", 256, 256, 200 },
+    };
+    struct Game g;
+    size_t i;
+
+    for (i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+        bench_GAME(&g, sizes[i].side_x, sizes[i].side_y, ENEMIES_MIN);
+        bench_RUN(sizes[i].name, bench_plot, &g, sizes[i].ops);
+        game_deinit(&g);
+    }
+}
+
+/*
+ * Hunt paths.
+ * ===========
+ */
+
+struct BenchPaths {
+    struct Data *data;
+    struct PathField *field;
+    struct Hpa *hpa;
+};
+
+/* Floods the field from a new player position and walks an enemy's path
+ * down it, like a hunt path search after the player moved. */
+static void bench_hunt_field(void *context, long ops)
+{
+    struct BenchPaths *b = context;
+    const int width = b->data->width;
+    long i;
+    int cell;
+
+    for (i = 0; i < ops; ++i) {
+        const int k = i % BENCH_LINES;
+        path_field_update(b->field, b->data, lines.y2[k] * width + lines.x2[k]);
+        cell = lines.y1[k] * width + lines.x1[k];
+        while ((cell = path_field_next(b->field, cell)) != -1) {
+        }
+    }
+}
+
+static void bench_hunt_hpa(void *context, long ops)
+{
+    struct BenchPaths *b = context;
+    const int width = b->data->width;
+    long i;
+
+    for (i = 0; i < ops; ++i) {
+        const int k = i % BENCH_LINES;
+        bench_sink = hpa_find(b->hpa, b->data,
+                lines.y1[k] * width + lines.x1[k],
+                lines.y2[k] * width + lines.x2[k]);
+    }
+}
+
+static void bench_paths(void)
+{
+    static const struct { int side; long ops; } sizes[] = {
+        { 64, 4000 },
+        { 256, 200 },
+        { 1024, 10 },
+    };
+    char name[BENCH_NAME_MAX];
+    struct BenchPaths b;
+    struct Game g;
+    size_t i;
+
+    for (i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+        bench_GAME(&g, sizes[i].side, sizes[i].side, ENEMIES_MIN);
+        bench_LINES(&g.data);
+        b.data = &g.data;
+        b.field = path_field_create(g.data.width, g.data.height,
+                g.data.terrain_max);
+        b.hpa = hpa_create(g.data.width, g.data.height);
+
+        snprintf(name, sizeof(name), "hunt_field/%d", sizes[i].side);
+        bench_RUN(name, bench_hunt_field, &b, sizes[i].ops);
+        snprintf(name, sizeof(name), "hunt_hpa/%d", sizes[i].side);
+        bench_RUN(name, bench_hunt_hpa, &b, sizes[i].ops * 4);
+
+        path_field_destroy(b.field);
+        hpa_destroy(b.hpa);
+        game_deinit(&g);
+    }
+}
+
+/*
+ * Free fields.
+ * ============
+ */
+
+static void bench_find_empty(void *context, long ops)
+{
+    int x = 0, y = 0;
+    long i;
+
+    for (i = 0; i < ops; ++i) {
+        data_find_empty_field(context, &x, &y);
+    }
+    bench_sink = x + y;
+}
+
+static void bench_free_fields(void)
+{
+    struct Game g;
+
+    /* Nine in ten fields less the most the asteroids could cover: enemies
+     * on about 60% of the map, which with the asteroids leaves under a
+     * quarter of it free. */
+    bench_GAME(&g, 128, 128, 128 * 128 * 9 / 10 -
+            128 * 128 / (MAP_WIDTH * MAP_HEIGHT) * ASTEROIDS_MAX *
+            ASTEROID_SIDE_MAX * ASTEROID_SIDE_MAX);
+    bench_RUN("find_empty/dense", bench_find_empty, &g.data, 1000000);
+    game_deinit(&g);
+}
+
+/*
+ * Turns.
+ * ======
+ */
+
+struct BenchTurns {
+    struct Game game;
+    struct DataConfig config;
+    struct Rng rng;
+};
+
+/* Plays the random commands of the headless mode, starting a new match
+ * whenever one ends. */
+static void bench_turn(void *context, long ops)
+{
+    static const char moves[] = "hjkl";
+    struct BenchTurns *b = context;
+    struct Data *d = &b->game.data;
+    int c, target;
+    long i;
+
+    for (i = 0; i < ops; ++i) {
+        target = 0;
+        c = moves[rng_range(&b->rng, 0, 4)];
+        if (d->enemies_count > 0 && rng_range(&b->rng, 0, 8) == 0) {
+            target = d->enemies.id[rng_range(&b->rng, 0, d->enemies_count)];
+            c = 'L';
+        }
+        if (game_step(&b->game, c, target) != GR_CONTINUE) {
+            game_deinit(&b->game);
+            game_init(&b->game, &b->config);
+            game_plot(&b->game);
+        }
+    }
+}
+
+static void bench_turns(void)
+{
+    static const struct {
+        const char *name;
+        int side_x, side_y, enemies;
+        long ops;
+    } sizes[] = {
+        { "turn/40x20", 40, 20, ENEMIES_MIN, 20000 },
+        { "turn/256x256", 256, 256, 100, 300 },
+    };
+    struct BenchTurns b;
+    size_t i;
+
+    for (i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+        bench_GAME(&b.game, sizes[i].side_x, sizes[i].side_y,
+                sizes[i].enemies);
+        b.config = b.game.data.config;
+        rng_seed(&b.rng, BENCH_SEED);
+        game_plot(&b.game);
+        bench_RUN(sizes[i].name, bench_turn, &b, sizes[i].ops);
+        game_deinit(&b.game);
+    }
+}
+
+/*
+ * Main.
+ * =====
+ */
+
+static void print_usage(const char *program)
+{
+    printf("Usage: %s [options]\n", program);
+    printf("  -v VARIANT    Name of the build variant (default \"default\")\n");
+    printf("  -b FILE       Compare with the results in a baseline file\n");
+    printf("  -o FILE       Append the results to a file in the baseline\n"
+           "                format\n");
+    printf("  -t PERCENT    Slowdown tolerated before a benchmark counts as\n"
+           "                a regression, required with -b\n");
+}
+
+static bool args_parse(int argc, char *argv[])
+{
+    char *end;
+    int opt;
+
+    options.variant = "default";
+    options.baseline = NULL;
+    options.output = NULL;
+    options.tolerance = -1.0;
+
+    while ((opt = getopt(argc, argv, "v:b:o:t:")) != -1) {
+        switch (opt) {
+        case 'v':
+            options.variant = optarg;
+            break;
+        case 'b':
+            options.baseline = optarg;
+            break;
+        case 'o':
+            options.output = optarg;
+            break;
+        case 't':
+            options.tolerance = strtod(optarg, &end);
+            if (end == optarg || *end != '\0' || options.tolerance < 0.0) {
+                print_usage(argv[0]);
+                return false;
+            }
+            break;
+        default:
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    if (options.baseline != NULL && options.tolerance < 0.0) {
+        fprintf(stderr, "ERROR: Comparing with a baseline needs a tolerance.\n");
+        return false;
+    }
+    if (strlen(options.variant) >= BENCH_NAME_MAX) {
+        fprintf(stderr, "ERROR: Variant name too long.\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (!args_parse(argc, argv)) {
+        return 1;
+    }
+    if (options.baseline != NULL && !bench_baseline_LOAD(options.baseline)) {
+        return 1;
+    }
+    if (options.output != NULL &&
+        (output = fopen(options.output, "a")) == NULL) {
+            fprintf(stderr, "ERROR: Failed opening %s.\n", options.output);
+            return 1;
+    }
+
+    bench_scans();
+    bench_plots();
+    bench_paths();
+    bench_free_fields();
+    bench_turns();
+
+    if (output != NULL) {
+        fclose(output);
+    }
+    if (regressions > 0) {
+        printf("%d regressions against %s.\n", regressions, options.baseline);
+        return 1;
+    }
+    return 0;
+}
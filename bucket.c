@@ -0,0 +1,67 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "bucket.h"
+
+#define BUCKET_INITIAL 64
+
+void bucket_queue_init(struct BucketQueue *q, int span)
+{
+    int i, size = 1;
+
+    while (size < span) {
+        size *= 2;
+    }
+    q->mask = size - 1;
+    q->key = 0;
+    q->count = 0;
+    q->buckets = calloc(size, sizeof(*q->buckets));
+    if (!q->buckets) {
+        fprintf(stderr, "ERROR: Failed allocating the bucket queue.\n");
+        exit(1);
+    }
+    for (i = 0; i < size; ++i) {
+        q->buckets[i].capacity = BUCKET_INITIAL;
+        q->buckets[i].cells =
+            malloc(BUCKET_INITIAL * sizeof(*q->buckets[i].cells));
+        if (!q->buckets[i].cells) {
+            fprintf(stderr, "ERROR: Failed allocating the bucket queue.\n");
+            exit(1);
+        }
+    }
+}
+
+void bucket_queue_free(struct BucketQueue *q)
+{
+    int i;
+
+    for (i = 0; q->buckets != NULL && i <= q->mask; ++i) {
+        free(q->buckets[i].cells);
+    }
+    free(q->buckets);
+    q->buckets = NULL;
+    q->count = 0;
+}
+
+void bucket_queue_reset(struct BucketQueue *q, int key)
+{
+    int i;
+
+    if (q->count > 0) {
+        for (i = 0; i <= q->mask; ++i) {
+            q->buckets[i].head = q->buckets[i].length = 0;
+        }
+    }
+    q->key = key;
+    q->count = 0;
+}
+
+void bucket_grow(struct Bucket *b)
+{
+    b->capacity *= 2;
+    b->cells = realloc(b->cells, b->capacity * sizeof(*b->cells));
+    if (!b->cells) {
+        fprintf(stderr, "ERROR: Failed growing the bucket queue.\n");
+        exit(1);
+    }
+}
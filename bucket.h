@@ -0,0 +1,110 @@
+#ifndef BUCKET_H
+#define BUCKET_H
+
+#include <stdbool.h>
+
+/*
+ * Bucket queue, also known as Dial's queue, for searches whose steps cost
+ * small positive integers. A ring of buckets holds the keys from the last
+ * popped one up to span - 1 above it, so pushing and popping are O(1)
+ * instead of the O(log n) of a heap. Cells pushed with the same key
+ * come out in the order they were pushed, which makes a search with unit
+ * costs visit the fields in the same order as a breadth-first one.
+ *
+ * Keys are never decreased in place: a cell whose key improved is pushed
+ * again and the caller skips the stale entries it pops.
+ */
+
+struct Bucket {
+    int *cells;
+    int head, length, capacity;
+};
+
+struct BucketQueue {
+    /* The ring size, a power of two no smaller than the span. */
+    int mask;
+    int key;
+    int count;
+    struct Bucket *buckets;
+};
+
+/** @brief Prepares an empty queue.
+  * @param q The queue.
+  * @param span One more than the largest key increase of a single push
+  *        over the last popped key.
+  */
+void bucket_queue_init(struct BucketQueue *q, int span);
+void bucket_queue_free(struct BucketQueue *q);
+
+/** @brief Empties the queue and makes key the lowest one it accepts. */
+void bucket_queue_reset(struct BucketQueue *q, int key);
+
+/** @brief Makes room for one more cell in a full bucket. */
+void bucket_grow(struct Bucket *b);
+
+/** @brief Adds a cell with a key between the last popped key and
+  *        span - 1 above it.
+  */
+static inline void bucket_queue_push(struct BucketQueue *q, int key, int cell)
+{
+    struct Bucket *b = &q->buckets[key & q->mask];
+
+    if (b->length == b->capacity) {
+        bucket_grow(b);
+    }
+    b->cells[b->length++] = cell;
+    ++q->count;
+}
+
+/** @brief Removes a cell with the lowest key.
+  * @param q The queue, which must not be empty.
+  * @param[out] key The key the cell was pushed with.
+  * @return The cell.
+  */
+static inline int bucket_queue_pop(struct BucketQueue *q, int *key)
+{
+    struct Bucket *b = &q->buckets[q->key & q->mask];
+
+    /* A drained bucket is rewound before the ring moves past it, so it
+     * starts empty when it comes round for a later key. */
+    while (b->head == b->length) {
+        b->head = b->length = 0;
+        b = &q->buckets[++q->key & q->mask];
+    }
+    --q->count;
+    *key = q->key;
+    return b->cells[b->head++];
+}
+
+/** @brief Removes all the cells with the lowest key at once, for searches
+  *        whose steps cost at least 1 and so never push another cell with
+  *        that key while going through them.
+  * @param q The queue, which must not be empty.
+  * @param[out] cells The cells, valid until the next pop or take.
+  * @param[out] key The key the cells were pushed with.
+  * @return The number of cells.
+  */
+static inline int bucket_queue_take(
+        struct BucketQueue *q, const int **cells, int *key)
+{
+    struct Bucket *b = &q->buckets[q->key & q->mask];
+    int count;
+
+    while (b->head == b->length) {
+        b->head = b->length = 0;
+        b = &q->buckets[++q->key & q->mask];
+    }
+    count = b->length - b->head;
+    *cells = b->cells + b->head;
+    b->head = b->length;
+    q->count -= count;
+    *key = q->key;
+    return count;
+}
+
+static inline bool bucket_queue_empty(const struct BucketQueue *q)
+{
+    return q->count == 0;
+}
+
+#endif
@@ -1,19 +1,31 @@
+/* Defaults, overridable at startup. */
 #define MAP_WIDTH 40
 #define MAP_HEIGHT 20
-#define MAX_RANDOM_SEEKS (10 * MAP_WIDTH * MAP_HEIGHT)
-#define MAX_SCAN_LINE_SIZE ((int)(MAP_SIDE * 1.5))
 #define ASTEROIDS_MIN 3
-#define ASTEROIDS_MAX 5 
+#define ASTEROIDS_MAX 5
 #define ASTEROID_SIDE_MIN 3
 #define ASTEROID_SIDE_MAX 7
 #define ENEMIES_MIN 3
 #define ENEMIES_MAX 5
+#define NEBULAE_MIN 0
+#define NEBULAE_MAX 0
+#define MARGIN_COST 1
 
-#define FAKE_PLAYER_INDEX 999
-#define FAKE_ASTEROID_INDEX -1
+/* Hard limits. */
+#define MAP_SIDE_MIN 2
+#define MAP_SIDE_MAX 4096
+
+#define CACHE_LINE_SIZE 64
+#define ENEMIES_INITIAL_CAPACITY 16
+#define HPA_CLUSTER_SIDE 16
 
-#if MAP_WIDTH < 2 || MAP_HEIGHT < 2
-#	error Map side too small!
-#endif
+/* Terrain: the cost of stepping onto a field, 1 for open space. */
+#define TERRAIN_COST_MAX 8
+#define NEBULA_COST 4
+/* Nebula sides, both bounds included. */
+#define NEBULA_SIDE_MIN 4
+#define NEBULA_SIDE_MAX 12
 
+#define FAKE_PLAYER_INDEX 999
+#define FAKE_ASTEROID_INDEX -1
 
@@ -2,97 +2,457 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-#include "xeno.h"
 #include "data.h"
+#include "sight.h"
 
-void data_init_map(struct Data *d)
+void data_config_default(struct DataConfig *config)
 {
-    memset(d->map_buffer, SF_UNSCANNED, sizeof(d->map_buffer));
+    config->width = MAP_WIDTH;
+    config->height = MAP_HEIGHT;
+    config->asteroids_min = ASTEROIDS_MIN;
+    config->asteroids_max = ASTEROIDS_MAX;
+    config->asteroid_side_min = ASTEROID_SIDE_MIN;
+    config->asteroid_side_max = ASTEROID_SIDE_MAX;
+    config->enemies_min = ENEMIES_MIN;
+    config->enemies_max = ENEMIES_MAX;
+    config->nebulae_min = NEBULAE_MIN;
+    config->nebulae_max = NEBULAE_MAX;
+    config->margin_cost = MARGIN_COST;
+    config->paths_mode = POOL_KEEP;
+}
+
+const char *data_config_check(const struct DataConfig *config)
+{
+    if (config->width < MAP_SIDE_MIN || config->width > MAP_SIDE_MAX ||
+        config->height < MAP_SIDE_MIN || config->height > MAP_SIDE_MAX) {
+        return "Map side out of range.";
+    }
+    if (config->asteroids_min < 0 ||
+        config->asteroids_min > config->asteroids_max) {
+        return "Invalid asteroid count range.";
+    }
+    if (config->asteroid_side_min < 1 ||
+        config->asteroid_side_min > config->asteroid_side_max ||
+        config->asteroid_side_max >= config->width ||
+        config->asteroid_side_max >= config->height) {
+        return "Invalid asteroid side range.";
+    }
+    if (config->enemies_min < 0 ||
+        config->enemies_min > config->enemies_max) {
+        return "Invalid enemy count range.";
+    }
+    if (config->nebulae_min < 0 ||
+        config->nebulae_min > config->nebulae_max ||
+        config->nebulae_max > config->width * config->height) {
+        return "Invalid nebula count range.";
+    }
+    if (config->margin_cost < 1 || config->margin_cost > TERRAIN_COST_MAX) {
+        return "Invalid asteroid margin cost.";
+    }
+    return NULL;
+}
+
+void *data_alloc(size_t size)
+{
+    const size_t aligned_size =
+        (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    void *result = aligned_alloc(CACHE_LINE_SIZE,
+            aligned_size ? aligned_size : CACHE_LINE_SIZE);
+    if (!result) {
+        fprintf(stderr, "ERROR: Failed allocating %zu bytes.\n", size);
+        exit(1);
+    }
+    return result;
+}
+
+/* Moves the used part of an aligned block into a bigger one. */
+static void *data_GROW(void *old, size_t used_size, size_t new_size)
+{
+    void *result = data_alloc(new_size);
+    if (old) {
+        memcpy(result, old, used_size);
+        free(old);
+    }
+    return result;
+}
+
+#define DATA_GROW_ENEMIES(MACRO_field)\
+    d->enemies.MACRO_field = data_GROW(\
+            d->enemies.MACRO_field,\
+            d->enemies_count * sizeof(*d->enemies.MACRO_field),\
+            capacity * sizeof(*d->enemies.MACRO_field))
+
+static void data_enemies_RESERVE(struct Data *d, int capacity)
+{
+    if (capacity <= d->enemies_capacity) {
+        return;
+    }
+    DATA_GROW_ENEMIES(x);
+    DATA_GROW_ENEMIES(y);
+    DATA_GROW_ENEMIES(behavior);
+    DATA_GROW_ENEMIES(id);
+    DATA_GROW_ENEMIES(hunt_path);
+    DATA_GROW_ENEMIES(hunt_path_length);
+    DATA_GROW_ENEMIES(hunt_path_step);
+    DATA_GROW_ENEMIES(hunt_path_drift);
+    d->enemies_capacity = capacity;
+}
+
+void data_init_map(struct Data *d, const struct DataConfig *config)
+{
+    const size_t size = (size_t)config->width * config->height;
+    const size_t plane_size = (size + 63) / 64 * sizeof(uint64_t);
+
+    d->config = *config;
+    d->width = config->width;
+    d->height = config->height;
+
+    d->asteroids = data_alloc(config->asteroids_max * sizeof(*d->asteroids));
+    d->asteroids_count = 0;
+    memset(&d->enemies, 0, sizeof(d->enemies));
+    d->enemies_count = 0;
+    d->enemies_capacity = 0;
+    data_enemies_RESERVE(d, config->enemies_max > ENEMIES_INITIAL_CAPACITY ?
+            config->enemies_max : ENEMIES_INITIAL_CAPACITY);
+
+    d->enemy_index = NULL;
+    d->enemy_ids_count = 0;
+    d->enemy_ids_capacity = 0;
+
+    d->paths = pool_create(config->paths_mode);
+    d->sight = sight_create(config->width, config->height);
+
+    d->enemy_map = data_alloc(size * sizeof(*d->enemy_map));
+    memset(d->enemy_map, -1, size * sizeof(*d->enemy_map));
+
+    d->free_cells = data_alloc(size * sizeof(*d->free_cells));
+    d->free_slot = data_alloc(size * sizeof(*d->free_slot));
+    d->free_count = 0;
+
+    d->explored = data_alloc(plane_size);
+    d->visible = data_alloc(plane_size);
+    d->blocked = data_alloc(plane_size);
+    d->occupied = data_alloc(plane_size);
+    memset(d->explored, 0, plane_size);
+    memset(d->visible, 0, plane_size);
+    memset(d->blocked, 0, plane_size);
+    memset(d->occupied, 0, plane_size);
+
+    d->terrain = data_alloc(size * sizeof(*d->terrain));
+    memset(d->terrain, 1, size * sizeof(*d->terrain));
+    d->terrain_max = 1;
+}
+
+void data_free(struct Data *d)
+{
+    pool_destroy(d->paths);
+    sight_destroy(d->sight);
+    free(d->asteroids);
+    free(d->enemies.x);
+    free(d->enemies.y);
+    free(d->enemies.behavior);
+    free(d->enemies.id);
+    free(d->enemies.hunt_path);
+    free(d->enemies.hunt_path_length);
+    free(d->enemies.hunt_path_step);
+    free(d->enemies.hunt_path_drift);
+    free(d->enemy_map);
+    free(d->free_cells);
+    free(d->free_slot);
+    free(d->enemy_index);
+    free(d->explored);
+    free(d->visible);
+    free(d->blocked);
+    free(d->occupied);
+    free(d->terrain);
+    d->asteroids = NULL;
+    memset(&d->enemies, 0, sizeof(d->enemies));
+    d->enemy_map = NULL;
+    d->free_cells = NULL;
+    d->free_slot = NULL;
+    d->free_count = 0;
+    d->enemy_index = NULL;
+    d->paths = NULL;
+    d->sight = NULL;
+    d->explored = NULL;
+    d->visible = NULL;
+    d->blocked = NULL;
+    d->occupied = NULL;
+    d->terrain = NULL;
+    d->terrain_max = 1;
+    d->asteroids_count = 0;
+    d->enemies_count = 0;
+    d->enemies_capacity = 0;
+    d->enemy_ids_count = 0;
+    d->enemy_ids_capacity = 0;
+}
+
+static void data_init_asteroids_RASTER(struct Data *d)
+{
+    int i, x, y;
+    for (i = 0; i < d->asteroids_count; ++i) {
+        for (y = d->asteroids[i].y1; y <= d->asteroids[i].y2; ++y) {
+            for (x = d->asteroids[i].x1; x <= d->asteroids[i].x2; ++x) {
+                data_plane_set(d->blocked, y * d->width + x);
+            }
+        }
+    }
 }
 
 void data_init_asteroids(struct Data *d)
 {
     int i;
-    d->asteroids_count = XENO_rand_range(ASTEROIDS_MIN, ASTEROIDS_MAX);
-    printf("Generating %d asteroids.\n", d->asteroids_count);
+    d->asteroids_count = rng_range(&d->rng,
+            d->config.asteroids_min, d->config.asteroids_max);
     for (i = 0; i < d->asteroids_count; ++i) {
-        int width = XENO_rand_range(ASTEROID_SIDE_MIN, ASTEROID_SIDE_MAX);
-        int height = XENO_rand_range(ASTEROID_SIDE_MIN, ASTEROID_SIDE_MAX);
-        int x = XENO_rand_range(0, MAP_WIDTH - width);
-        int y = XENO_rand_range(0, MAP_HEIGHT - height);
+        int width = rng_range(&d->rng,
+                d->config.asteroid_side_min, d->config.asteroid_side_max);
+        int height = rng_range(&d->rng,
+                d->config.asteroid_side_min, d->config.asteroid_side_max);
+        int x = rng_range(&d->rng, 0, d->width - width);
+        int y = rng_range(&d->rng, 0, d->height - height);
         d->asteroids[i].x1 = x;
         d->asteroids[i].y1 = y;
         d->asteroids[i].x2 = x + width;
         d->asteroids[i].y2 = y + height;
     }
+    data_init_asteroids_RASTER(d);
+    data_index_free_cells(d);
+}
+
+/* Raises the cost of a field to at least the given one. */
+static void data_terrain_RAISE(struct Data *d, int x, int y, int cost)
+{
+    uint8_t *field = &d->terrain[y * d->width + x];
+
+    if (*field < cost) {
+        *field = cost;
+        if (cost > d->terrain_max) {
+            d->terrain_max = cost;
+        }
+    }
+}
+
+void data_init_terrain(struct Data *d)
+{
+    const int cost = d->config.margin_cost;
+    const int side = d->width < d->height ? d->width : d->height;
+    const int side_max = NEBULA_SIDE_MAX < side ? NEBULA_SIDE_MAX : side;
+    const int side_min = NEBULA_SIDE_MIN < side_max ? NEBULA_SIDE_MIN : side_max;
+    int i, x, y, x1, y1, width, height, count = 0;
+
+    /* The fields next to an asteroid. */
+    for (y = 0; cost > 1 && y < d->height; ++y) {
+        for (x = 0; x < d->width; ++x) {
+            if (!data_is_blocked(d, x, y) &&
+                ((x > 0 && data_is_blocked(d, x - 1, y)) ||
+                 (x < d->width - 1 && data_is_blocked(d, x + 1, y)) ||
+                 (y > 0 && data_is_blocked(d, x, y - 1)) ||
+                 (y < d->height - 1 && data_is_blocked(d, x, y + 1)))) {
+                    data_terrain_RAISE(d, x, y, cost);
+            }
+        }
+    }
+
+    /* Maps without nebulae leave the random generator untouched. */
+    if (d->config.nebulae_max > 0) {
+        count = rng_range(&d->rng,
+                d->config.nebulae_min, d->config.nebulae_max + 1);
+    }
+    for (i = 0; i < count; ++i) {
+        width = rng_range(&d->rng, side_min, side_max + 1);
+        height = rng_range(&d->rng, side_min, side_max + 1);
+        x1 = rng_range(&d->rng, 0, d->width - width);
+        y1 = rng_range(&d->rng, 0, d->height - height);
+        for (y = y1; y < y1 + height; ++y) {
+            for (x = x1; x < x1 + width; ++x) {
+                data_terrain_RAISE(d, x, y, NEBULA_COST);
+            }
+        }
+    }
 }
 
 void data_init_enemies(struct Data *d)
 {
-    int i;
-    int new_count = XENO_rand_range(ENEMIES_MIN, ENEMIES_MAX);
-    d->enemies_count = 0;
+    int i, x, y;
+    int new_count = rng_range(&d->rng,
+            d->config.enemies_min, d->config.enemies_max);
     for (i = 0; i < new_count; ++i) {
-        if (!data_find_empty_field(d,
-                MAX_RANDOM_SEEKS,
-                &(d->enemies[i].x),
-                &(d->enemies[i].y))) {
-            fprintf(stderr, "ERROR: Failed finding random free field too many times.\n");
+        if (!data_find_empty_field(d, &x, &y)) {
+            fprintf(stderr, "ERROR: No free field left for an enemy.\n");
             exit(1);
         }
-        d->enemies[i].behavior = EB_IDLE;
-        d->enemies[i].hunt_path = NULL;
-        d->enemies[i].hunt_path_length = 0;
-        d->enemies[i].hunt_path_step = 0;
-        ++(d->enemies_count);
+        data_enemy_add(d, x, y);
     }
 }
 
 void data_init_player(struct Data *d)
 {
     d->player.health = 100.0;
-    if (!data_find_empty_field(d,
-            MAX_RANDOM_SEEKS,
-            &(d->player.x),
-            &(d->player.y))) {
-        fprintf(stderr, "ERROR: Failed finding random free field too many times.\n");
+    if (!data_find_empty_field(d, &(d->player.x), &(d->player.y))) {
+        fprintf(stderr, "ERROR: No free field left for the player.\n");
         exit(1);
     }
-    printf("Generating player at (%d, %d).\n", d->player.x, d->player.y);
+}
+
+static void data_free_cell_ADD(struct Data *d, int cell)
+{
+    d->free_slot[cell] = d->free_count;
+    d->free_cells[d->free_count++] = cell;
+}
+
+/* Swaps the last free field into the place of the taken one. */
+static void data_free_cell_TAKE(struct Data *d, int cell)
+{
+    const int slot = d->free_slot[cell];
+    const int last = d->free_cells[--d->free_count];
+
+    d->free_cells[slot] = last;
+    d->free_slot[last] = slot;
+    d->free_slot[cell] = -1;
+}
+
+void data_index_free_cells(struct Data *d)
+{
+    const int size = d->width * d->height;
+    int cell;
+
+    d->free_count = 0;
+    for (cell = 0; cell < size; ++cell) {
+        if (data_plane_get(d->blocked, cell) ||
+            data_plane_get(d->occupied, cell)) {
+            d->free_slot[cell] = -1;
+        } else {
+            data_free_cell_ADD(d, cell);
+        }
+    }
+}
+
+void data_enemies_reserve(struct Data *d, int capacity, int ids_capacity)
+{
+    data_enemies_RESERVE(d, capacity);
+    if (ids_capacity > d->enemy_ids_capacity) {
+        d->enemy_index = data_GROW(d->enemy_index,
+                d->enemy_ids_count * sizeof(*d->enemy_index),
+                ids_capacity * sizeof(*d->enemy_index));
+        d->enemy_ids_capacity = ids_capacity;
+    }
+}
+
+int data_enemy_add(struct Data *d, int x, int y)
+{
+    const int index = d->enemies_count;
+    int id;
+
+    if (d->enemies_count == d->enemies_capacity) {
+        data_enemies_RESERVE(d, 2 * d->enemies_capacity);
+    }
+    if (d->enemy_ids_count == d->enemy_ids_capacity) {
+        data_enemies_reserve(d, d->enemies_capacity, d->enemy_ids_capacity ?
+                2 * d->enemy_ids_capacity : d->enemies_capacity);
+    }
+
+    id = d->enemy_ids_count++;
+    d->enemy_index[id] = index;
+
+    d->enemies.x[index] = x;
+    d->enemies.y[index] = y;
+    d->enemies.behavior[index] = EB_IDLE;
+    d->enemies.id[index] = id;
+    d->enemies.hunt_path[index] = NULL;
+    d->enemies.hunt_path_length[index] = 0;
+    d->enemies.hunt_path_step[index] = 0;
+    d->enemies.hunt_path_drift[index] = 0;
+    ++d->enemies_count;
+
+    d->enemy_map[y * d->width + x] = index;
+    data_plane_set(d->occupied, y * d->width + x);
+    data_free_cell_TAKE(d, y * d->width + x);
+    sight_touch(d->sight, y * d->width + x);
+
+    return index;
+}
+
+void data_enemy_remove(struct Data *d, int index)
+{
+    const int last = d->enemies_count - 1;
+
+    d->enemy_map[d->enemies.y[index] * d->width + d->enemies.x[index]] = -1;
+    data_plane_clear(d->occupied,
+            d->enemies.y[index] * d->width + d->enemies.x[index]);
+    data_free_cell_ADD(d,
+            d->enemies.y[index] * d->width + d->enemies.x[index]);
+    sight_touch(d->sight,
+            d->enemies.y[index] * d->width + d->enemies.x[index]);
+    d->enemy_index[d->enemies.id[index]] = -1;
+    pool_free(d->paths, d->enemies.hunt_path[index]);
+
+    if (index != last) {
+        d->enemies.x[index] = d->enemies.x[last];
+        d->enemies.y[index] = d->enemies.y[last];
+        d->enemies.behavior[index] = d->enemies.behavior[last];
+        d->enemies.id[index] = d->enemies.id[last];
+        d->enemies.hunt_path[index] = d->enemies.hunt_path[last];
+        d->enemies.hunt_path_length[index] = d->enemies.hunt_path_length[last];
+        d->enemies.hunt_path_step[index] = d->enemies.hunt_path_step[last];
+        d->enemies.hunt_path_drift[index] = d->enemies.hunt_path_drift[last];
+
+        d->enemy_map[d->enemies.y[index] * d->width + d->enemies.x[index]] = index;
+        d->enemy_index[d->enemies.id[index]] = index;
+    }
+
+    --d->enemies_count;
+}
+
+void data_enemy_set_path(struct Data *d, int index, int *path, int length)
+{
+    pool_free(d->paths, d->enemies.hunt_path[index]);
+    d->enemies.hunt_path[index] = path;
+    d->enemies.hunt_path_length[index] = length;
+    d->enemies.hunt_path_step[index] = 0;
+    d->enemies.hunt_path_drift[index] = 0;
+}
+
+void data_reset_paths(struct Data *d)
+{
+    int i;
+    for (i = 0; i < d->enemies_count; ++i) {
+        d->enemies.hunt_path[i] = NULL;
+        d->enemies.hunt_path_length[i] = 0;
+        d->enemies.hunt_path_step[i] = 0;
+        d->enemies.hunt_path_drift[i] = 0;
+    }
+    pool_reset(d->paths);
+}
+
+void data_enemy_move(struct Data *d, int index, int x, int y)
+{
+    d->enemy_map[d->enemies.y[index] * d->width + d->enemies.x[index]] = -1;
+    data_plane_clear(d->occupied,
+            d->enemies.y[index] * d->width + d->enemies.x[index]);
+    data_free_cell_ADD(d,
+            d->enemies.y[index] * d->width + d->enemies.x[index]);
+    sight_touch(d->sight,
+            d->enemies.y[index] * d->width + d->enemies.x[index]);
+    d->enemies.x[index] = x;
+    d->enemies.y[index] = y;
+    d->enemy_map[y * d->width + x] = index;
+    data_plane_set(d->occupied, y * d->width + x);
+    data_free_cell_TAKE(d, y * d->width + x);
+    sight_touch(d->sight, y * d->width + x);
 }
 
 bool data_find_empty_field(
     struct Data *d,
-    int max_seeks,
     int *out_x, int *out_y)
 {
-    int i, x, y;
-    bool found = false;
-    int seeks = 0;
-    while (!found) {
-seek_fail:
-        if (++seeks > max_seeks) {
-            return false;
-        }
-        x = XENO_rand_range(0, MAP_WIDTH);
-        y = XENO_rand_range(0, MAP_HEIGHT);
-        for (i = 0; i < d->asteroids_count; ++i) {
-            if (x >= d->asteroids[i].x1 && x <= d->asteroids[i].x2 &&
-                y >= d->asteroids[i].y1 && y <= d->asteroids[i].y2) {
-                found = false;
-                goto seek_fail;
-            }
-        }
-        for (i = 0; i < d->enemies_count; ++i) {
-            if (x == d->enemies[i].x && y == d->enemies[i].y) {
-                found = false;
-                goto seek_fail;
-            }
-        }
-        found = true;
+    int cell;
+    if (d->free_count == 0) {
+        return false;
     }
-    *out_x = x;
-    *out_y = y;
+    cell = d->free_cells[rng_range(&d->rng, 0, d->free_count)];
+    *out_x = cell % d->width;
+    *out_y = cell / d->width;
     return true;
 }
 
@@ -2,7 +2,13 @@
 #define DATA_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "config.h"
+#include "rng.h"
+#include "pool.h"
+
+struct Sight;
 
 enum scan_field {
     SF_UNSCANNED = '~',
@@ -10,7 +16,8 @@ enum scan_field {
     SF_FOG = '.',
     SF_ASTEROID = '#',
     SF_PLAYER = '*',
-    SF_PATH = '`'
+    SF_PATH = '`',
+    SF_ROUGH = ':'
 };
 
 enum move_result {
@@ -24,43 +31,214 @@ enum enemy_behavior {
     EB_HUNT
 };
 
+struct DataConfig {
+    int width, height;
+    int asteroids_min, asteroids_max;
+    int asteroid_side_min, asteroid_side_max;
+    int enemies_min, enemies_max;
+    int nebulae_min, nebulae_max;
+    /* Cost of stepping onto a field next to an asteroid. */
+    int margin_cost;
+    enum pool_mode paths_mode;
+};
+
 struct Data {
 
-    struct { int x1, y1, x2, y2; } asteroids[ASTEROIDS_MAX];
+    struct DataConfig config;
+    int width, height;
+
+    struct Rng rng;
+
+    struct { int x1, y1, x2, y2; } *asteroids;
     int asteroids_count;
 
+    /* Enemies are kept as parallel arrays under a dense index, which
+     * changes when another enemy is removed. The id stays the same for
+     * the lifetime of an enemy. */
     struct {
-        int x, y;
-        enum enemy_behavior behavior;
-        int *hunt_path;
-        int hunt_path_length;
-        int hunt_path_step;
-    } enemies[ENEMIES_MAX];
+        int *x, *y;
+        enum enemy_behavior *behavior;
+        int *id;
+        /* Allocated from the paths pool. */
+        int **hunt_path;
+        int *hunt_path_length;
+        int *hunt_path_step;
+        /* How much more than the cheapest path to the player the path
+         * may cost, in terrain cost, after it was repaired instead of
+         * searched again. */
+        int *hunt_path_drift;
+    } enemies;
     int enemies_count;
+    int enemies_capacity;
+
+    /* Enemy index by field, -1 where there is no enemy. */
+    int *enemy_map;
+
+    /* Fields free of asteroids and enemies in no particular order, and
+     * the position of each field in that list, -1 for taken fields. */
+    int *free_cells;
+    int *free_slot;
+    int free_count;
+
+    /* Enemy index by id, -1 for destroyed enemies. */
+    int *enemy_index;
+    int enemy_ids_count;
+    int enemy_ids_capacity;
+
+    /* Owns the hunt paths of all the enemies. */
+    struct Pool *paths;
+
+    /* Cached lines of sight, told about every enemy entering or leaving
+     * a field. */
+    struct Sight *sight;
 
     struct {
         int x, y;
         double health;
     } player;
 
-    char map_buffer[MAP_WIDTH * MAP_HEIGHT];
+    /* Bit planes with one bit per field: fields ever seen by the player,
+     * fields seen in the last plot, fields covered by an asteroid and
+     * fields occupied by an enemy. The glyphs are only made when the map
+     * is drawn. */
+    uint64_t *explored;
+    uint64_t *visible;
+    uint64_t *blocked;
+    uint64_t *occupied;
+
+    /* Cost of stepping onto each field, from 1 for open space up to
+     * TERRAIN_COST_MAX inside nebulae and next to the asteroids, and
+     * the highest cost found on the map. */
+    uint8_t *terrain;
+    int terrain_max;
 
 };
 
-void data_init_map(struct Data *d);
+/** @brief Fills a configuration with the compile-time defaults. */
+void data_config_default(struct DataConfig *config);
+
+/** @brief Checks that a configuration describes a playable map.
+  * @return NULL if the configuration is valid, a description of the
+  *         first problem found otherwise.
+  */
+const char *data_config_check(const struct DataConfig *config);
+
+/** @brief Allocates a cache-aligned block, terminating on failure. */
+void *data_alloc(size_t size);
+
+/** @brief Allocates the storage for a map of the configured size.
+  *        Must be called before the other initialization functions.
+  */
+void data_init_map(struct Data *d, const struct DataConfig *config);
+void data_free(struct Data *d);
 void data_init_asteroids(struct Data *d);
+
+/** @brief Prices the fields around the asteroids and inside the randomly
+  *        placed nebulae. Must follow data_init_asteroids.
+  */
+void data_init_terrain(struct Data *d);
 void data_init_enemies(struct Data *d);
 void data_init_player(struct Data *d);
 
-/** @brief Finds a random field that is not occupied.
-  * @param[in] max_seeks The maximum number of acceptable fails.
+/** @brief Returns the number of words in each bit plane. */
+static inline size_t data_plane_words(const struct Data *d)
+{
+    return ((size_t)d->width * d->height + 63) / 64;
+}
+
+static inline bool data_plane_get(const uint64_t *plane, int cell)
+{
+    return (plane[cell >> 6] >> (cell & 63)) & 1;
+}
+
+static inline void data_plane_set(uint64_t *plane, int cell)
+{
+    plane[cell >> 6] |= UINT64_C(1) << (cell & 63);
+}
+
+static inline void data_plane_clear(uint64_t *plane, int cell)
+{
+    plane[cell >> 6] &= ~(UINT64_C(1) << (cell & 63));
+}
+
+/** @brief Checks whether a field is covered by an asteroid. The answer
+  *        comes from the raster built by data_init_asteroids.
+  * @param x The x coordinate of the checked field.
+  * @param y The y coordinate of the checked field.
+  * @return True if the field is blocked, false otherwise.
+  */
+static inline bool data_is_blocked(const struct Data *d, int x, int y)
+{
+    return data_plane_get(d->blocked, y * d->width + x);
+}
+
+/** @brief Returns the cost of stepping onto a field, at least 1. */
+static inline int data_terrain_cost(const struct Data *d, int cell)
+{
+    return d->terrain[cell];
+}
+
+/** @brief Checks which enemy occupies a field.
+  * @return The index of the enemy, -1 if the field is free.
+  */
+static inline int data_enemy_at(const struct Data *d, int x, int y)
+{
+    return d->enemy_map[y * d->width + x];
+}
+
+/** @brief Looks up an enemy by its id.
+  * @return The current index of the enemy, -1 if there is no such enemy.
+  */
+static inline int data_enemy_by_id(const struct Data *d, int id)
+{
+    if (id < 0 || id >= d->enemy_ids_count) {
+        return -1;
+    }
+    return d->enemy_index[id];
+}
+
+/** @brief Makes room for at least capacity enemies and ids_capacity ids
+  *        without changing the current ones.
+  */
+void data_enemies_reserve(struct Data *d, int capacity, int ids_capacity);
+
+/** @brief Adds an idle enemy with a new id at a free field.
+  * @return The index of the new enemy.
+  */
+int data_enemy_add(struct Data *d, int x, int y);
+
+/** @brief Removes an enemy in O(1) by moving the last enemy into its
+  *        index. The ids of all the enemies are preserved and the hunt
+  *        path of the removed enemy goes back to the paths pool.
+  */
+void data_enemy_remove(struct Data *d, int index);
+
+/** @brief Replaces the hunt path of an enemy, returning the old one to
+  *        the paths pool. The path must come from that pool.
+  */
+void data_enemy_set_path(struct Data *d, int index, int *path, int length);
+
+/** @brief Drops the hunt paths of all the enemies and recycles the whole
+  *        paths pool at once.
+  */
+void data_reset_paths(struct Data *d);
+
+/** @brief Moves an enemy to a free field. */
+void data_enemy_move(struct Data *d, int index, int x, int y);
+
+/** @brief Rebuilds the list of free fields from the blocked and occupied
+  *        planes. The enemy functions keep it up to date afterwards.
+  */
+void data_index_free_cells(struct Data *d);
+
+/** @brief Picks a field free of asteroids and enemies uniformly at random,
+  *        in O(1).
   * @param[out] out_x The x coordinate of the found point.
   * @param[out] out_y The y coordinate of the found point.
-  * @return True if seek was successfull, false otherwise.
+  * @return True if a field was found, false if there is no free field.
   */
 bool data_find_empty_field(
     struct Data *d,
-    int max_seeks,
     int *out_x, int *out_y);
 
 #endif
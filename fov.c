@@ -0,0 +1,104 @@
+#include "fov.h"
+#include "scan.h"
+
+/*
+ * Octant transformations: the scan always walks rows away from the
+ * viewpoint with dx in [-row, 0], these map it to map coordinates.
+ */
+static const int fov_octants[8][4] = {
+    {  1,  0,  0,  1 },
+    {  0,  1,  1,  0 },
+    {  0, -1,  1,  0 },
+    { -1,  0,  0,  1 },
+    { -1,  0,  0, -1 },
+    {  0, -1, -1,  0 },
+    {  0,  1, -1,  0 },
+    {  1,  0,  0, -1 }
+};
+
+struct FovScan {
+    struct Data *d;
+    int cx, cy;
+    int xx, xy, yx, yy;
+    int max_row;
+};
+
+static void fov_CAST(struct FovScan *s, int row, double start, double end)
+{
+    int j, dx, dy, x, y;
+    double l_slope, r_slope, new_start = 0.0;
+    bool blocked = false, opaque;
+
+    if (start < end) {
+        return;
+    }
+
+    for (j = row; j <= s->max_row && !blocked; ++j) {
+        dy = -j;
+        for (dx = -j; dx <= 0; ++dx) {
+            l_slope = (dx - 0.5) / (dy + 0.5);
+            r_slope = (dx + 0.5) / (dy - 0.5);
+            if (start < r_slope) {
+                continue;
+            } else if (end > l_slope) {
+                break;
+            }
+
+            x = s->cx + dx * s->xx + dy * s->xy;
+            y = s->cy + dx * s->yx + dy * s->yy;
+            if (x < 0 || x >= s->d->width || y < 0 || y >= s->d->height) {
+                opaque = false;
+            } else {
+                opaque = scan_plot(s->d, x, y) != 0;
+            }
+
+            if (blocked) {
+                if (opaque) {
+                    new_start = r_slope;
+                } else {
+                    blocked = false;
+                    start = new_start;
+                }
+            } else if (opaque && j < s->max_row) {
+                blocked = true;
+                fov_CAST(s, j + 1, start, l_slope);
+                new_start = r_slope;
+            }
+        }
+    }
+}
+
+/* Distance from the viewpoint to the map edge along an octant's rows. */
+static int fov_MAX_ROW(const struct Data *d, int cx, int cy, int xy, int yy)
+{
+    if (xy > 0) {
+        return cx;
+    } else if (xy < 0) {
+        return d->width - 1 - cx;
+    } else if (yy > 0) {
+        return cy;
+    } else {
+        return d->height - 1 - cy;
+    }
+}
+
+void fov_plot(struct Data *d, int x, int y)
+{
+    int i;
+    struct FovScan s;
+
+    s.d = d;
+    s.cx = x;
+    s.cy = y;
+
+    scan_plot(d, x, y);
+
+    for (i = 0; i < 8; ++i) {
+        s.xx = fov_octants[i][0];
+        s.xy = fov_octants[i][1];
+        s.yx = fov_octants[i][2];
+        s.yy = fov_octants[i][3];
+        s.max_row = fov_MAX_ROW(d, x, y, s.xy, s.yy);
+        fov_CAST(&s, 1, 1.0, 0.0);
+    }
+}
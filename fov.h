@@ -0,0 +1,16 @@
+#ifndef FOV_H
+#define FOV_H
+
+#include "data.h"
+
+/** @brief Marks all the fields visible from a point in the visible plane
+  *        using recursive shadowcasting. Each visible field is plotted
+  *        once with scan_plot, so asteroids and enemies are both marked
+  *        and cast shadows, while the shadowed fields are never visited.
+  * @param d The data in which the scan is performed.
+  * @param x The x coordinate of the viewpoint.
+  * @param y The y coordinate of the viewpoint.
+  */
+void fov_plot(struct Data *d, int x, int y);
+
+#endif
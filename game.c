@@ -0,0 +1,680 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "config.h"
+#include "game.h"
+#include "scan.h"
+#include "path.h"
+#include "hpa.h"
+#include "fov.h"
+#include "rng.h"
+#include "pool.h"
+#include "workers.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "sight.h"
+
+#define ENEMY_TURN_CHUNK 64
+/* A repaired hunt path is searched again once its drift, the most it can
+ * cost over the cheapest path, exceeds a quarter of the steps it has left.
+ * The steps are a lower bound of the cost left, so the drift stays under
+ * a quarter of that cost on any terrain. Repairs only extend the path to
+ * where the player went, the incremental search of D* Lite is not kept,
+ * and paths freed every turn with "-m turn" are never repaired. */
+#define HUNT_REPAIR_RATIO 4
+
+#define GAME_MESSAGE_MAX 80
+
+/* Formats a message for the game's receiver, if it has one. */
+static void game_MESSAGE(struct Game *g, const char *format, ...)
+{
+    char message[GAME_MESSAGE_MAX];
+    va_list args;
+
+    if (g->config.message == NULL) {
+        return;
+    }
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    g->config.message(g->config.message_context, message);
+}
+
+static void turn_free(struct Game *g)
+{
+    free(g->turn.sees);
+    free(g->turn.action);
+    free(g->turn.dx);
+    free(g->turn.dy);
+    free(g->turn.hit);
+    memset(&g->turn, 0, sizeof(g->turn));
+}
+
+static void turn_reserve(struct Game *g, int capacity)
+{
+    if (capacity <= g->turn.capacity) {
+        return;
+    }
+    turn_free(g);
+    g->turn.capacity = capacity;
+    g->turn.sees = data_alloc(capacity * sizeof(*g->turn.sees));
+    g->turn.action = data_alloc(capacity * sizeof(*g->turn.action));
+    g->turn.dx = data_alloc(capacity * sizeof(*g->turn.dx));
+    g->turn.dy = data_alloc(capacity * sizeof(*g->turn.dy));
+    g->turn.hit = data_alloc(capacity * sizeof(*g->turn.hit));
+}
+
+/* Allocates the engine state that goes with a freshly set up map. */
+static void game_init_ENGINE(struct Game *g)
+{
+    if (g->config.planner == HP_HPA) {
+        g->hpa = hpa_create(g->data.width, g->data.height);
+    } else {
+        g->field = path_field_create(g->data.width, g->data.height,
+                g->data.terrain_max);
+    }
+    turn_reserve(g, g->data.enemies_capacity);
+}
+
+void game_create(struct Game *g, const struct GameConfig *config, uint64_t seed)
+{
+    memset(g, 0, sizeof(*g));
+    g->config = *config;
+    rng_seed(&g->data.rng, seed);
+}
+
+void game_init(struct Game *g, const struct DataConfig *config)
+{
+    data_init_map(&g->data, config);
+    data_init_asteroids(&g->data);
+    data_init_terrain(&g->data);
+    data_init_enemies(&g->data);
+    data_init_player(&g->data);
+    game_MESSAGE(g, "Generating %d asteroids.\n", g->data.asteroids_count);
+    game_MESSAGE(g, "Generating player at (%d, %d).\n",
+            g->data.player.x, g->data.player.y);
+    game_init_ENGINE(g);
+}
+
+bool game_load(struct Game *g, const char *path)
+{
+    struct Snapshot snapshot;
+
+    if (!snapshot_open(&snapshot, path)) {
+        return false;
+    }
+    snapshot_restore(&snapshot, &g->data);
+    snapshot_close(&snapshot);
+
+    game_MESSAGE(g, "Loading snapshot %s.\n", path);
+    game_init_ENGINE(g);
+    return true;
+}
+
+void game_deinit(struct Game *g)
+{
+    turn_free(g);
+    path_field_destroy(g->field);
+    g->field = NULL;
+    hpa_destroy(g->hpa);
+    g->hpa = NULL;
+    data_free(&g->data);
+}
+
+/* Everything in view fades into fog before the view is plotted again. */
+static void plot_fog(struct Game *g)
+{
+    STATS_START(start);
+    memset(g->data.visible, 0,
+            data_plane_words(&g->data) * sizeof(*g->data.visible));
+    STATS_STOP(ST_PLOT_FOG, start);
+}
+
+static void plot_map(struct Game *g)
+{
+    size_t i;
+    STATS_START(start);
+    fov_plot(&g->data, g->data.player.x, g->data.player.y);
+    for (i = 0; i < data_plane_words(&g->data); ++i) {
+        g->data.explored[i] |= g->data.visible[i];
+    }
+    STATS_STOP(ST_PLOT_MAP, start);
+}
+
+void game_plot(struct Game *g)
+{
+    plot_fog(g);
+    plot_map(g);
+}
+
+/*
+ * Game engine.
+ * ============
+ */
+
+/* Runs a parallel job over the enemies on the workers, if there are any. */
+static void game_RUN(struct Game *g, workers_func func)
+{
+    if (g->config.workers != NULL) {
+        workers_run(g->config.workers, g->data.enemies_count,
+                ENEMY_TURN_CHUNK, func, g);
+    } else {
+        func(g, 0, 0, g->data.enemies_count);
+    }
+}
+
+/** @brief Gives an enemy the path to the player, built by descending the
+  *        shared distance field in O(path length), or by searching the
+  *        cluster graph of the hierarchical planner.
+  */
+static void game_find_hunt_path(struct Game *g, int index)
+{
+    const int src =
+            g->data.enemies.y[index] * g->data.width + g->data.enemies.x[index];
+    const int dst = g->data.player.y * g->data.width + g->data.player.x;
+    int i, length, cur = src;
+    int *path;
+
+    if (g->config.planner == HP_HPA) {
+        length = hpa_find(g->hpa, &g->data, src, dst);
+    } else {
+        path_field_update(g->field, &g->data, dst);
+        length = path_field_distance(g->field, src) + 1;
+        /* Costlier terrain makes the cost exceed the number of steps. */
+        if (length > 0 && g->data.terrain_max > 1) {
+            for (length = 1; (cur = path_field_next(g->field, cur)) != -1;
+                    ++length) {
+            }
+            cur = src;
+        }
+    }
+    if (length <= 0) {
+        data_enemy_set_path(&g->data, index, NULL, 0);
+        return;
+    }
+
+    path = pool_alloc(g->data.paths, length);
+    if (g->config.planner == HP_HPA) {
+        memcpy(path, hpa_path(g->hpa), length * sizeof(*path));
+    } else {
+        for (i = 0; i < length; ++i) {
+            path[i] = cur;
+            cur = path_field_next(g->field, cur);
+        }
+    }
+
+    data_enemy_set_path(&g->data, index, path, length);
+}
+
+/** @brief Makes an enemy's path end at the player again without searching,
+  *        after the player moved by one field. The path loses its last
+  *        field when the player stepped back onto it and gains the new one
+  *        otherwise. Each gained field can leave the path costlier than
+  *        the cheapest one by at most the cost of entering the old end and
+  *        the new one, which is added to its drift.
+  * @return False if the path drifted too far or the player jumped, and
+  *         has to be searched again.
+  */
+static bool game_repair_hunt_path(struct Game *g, int index)
+{
+    const int player = g->data.player.y * g->data.width + g->data.player.x;
+    const int length = g->data.enemies.hunt_path_length[index];
+    const int step = g->data.enemies.hunt_path_step[index];
+    int *path = g->data.enemies.hunt_path[index];
+    const int end = path[length - 1];
+    const int drift = g->data.enemies.hunt_path_drift[index] +
+            data_terrain_cost(&g->data, end) +
+            data_terrain_cost(&g->data, player);
+    int *grown;
+
+    if (end == player) {
+        return true;
+    }
+    if (length - step >= 2 && path[length - 2] == player) {
+        g->data.enemies.hunt_path_length[index] = length - 1;
+        return true;
+    }
+    if (abs(end % g->data.width - g->data.player.x) +
+        abs(end / g->data.width - g->data.player.y) != 1 ||
+        drift * HUNT_REPAIR_RATIO > length - step + 1) {
+            return false;
+    }
+
+    /* Out of room: move the part still ahead into a bigger array. */
+    if (length == pool_capacity(path)) {
+        grown = pool_alloc(g->data.paths, 2 * (length - step + 1));
+        memcpy(grown, path + step, (length - step) * sizeof(*grown));
+        data_enemy_set_path(&g->data, index, grown, length - step);
+        path = grown;
+    }
+
+    path[g->data.enemies.hunt_path_length[index]++] = player;
+    g->data.enemies.hunt_path_drift[index] = drift;
+    return true;
+}
+
+static enum move_result game_try_move(struct Game *g, int new_x, int new_y)
+{
+    const bool outside = new_x < 0 || new_x >= g->data.width ||
+                   new_y < 0 || new_y >= g->data.height;
+
+    const bool obstacle = !outside && data_is_blocked(&g->data, new_x, new_y);
+    const bool enemy = !outside && data_enemy_at(&g->data, new_x, new_y) != -1;
+    const bool player =
+            (new_x == g->data.player.x && new_y == g->data.player.y);
+
+    if (obstacle || outside) {
+        return MR_BLOCK;
+    } else if (enemy || player) {
+        return MR_SHIP;
+    } else {
+        return MR_CLEAR;
+    }
+}
+
+static void game_move_player(struct Game *g, int dx, int dy)
+{
+    const int new_x = g->data.player.x + dx;
+    const int new_y = g->data.player.y + dy;
+
+    switch (game_try_move(g, new_x, new_y)) {
+    case MR_CLEAR:
+        g->data.player.x = new_x;
+        g->data.player.y = new_y;
+        /* Intentional fall-through! */
+    case MR_BLOCK:
+        break;
+    case MR_SHIP:
+        g->data.player.health = 0.0;
+        break;
+    }
+}
+
+static void game_move_enemy(struct Game *g, int index, int dx, int dy)
+{
+    const int new_x = g->data.enemies.x[index] + dx;
+    const int new_y = g->data.enemies.y[index] + dy;
+
+    switch (game_try_move(g, new_x, new_y)) {
+    case MR_CLEAR:
+        data_enemy_move(&g->data, index, new_x, new_y);
+        /* Intentional fall-through! */
+    case MR_BLOCK:
+    case MR_SHIP:
+        break;
+    }
+}
+
+static void game_hit_enemy(struct Game *g, int index)
+{
+    data_enemy_remove(&g->data, index);
+}
+
+static void game_hit_player(struct Game *g)
+{
+    g->data.player.health = 100.0;
+}
+
+static bool game_fire_laser(struct Game *g, int target_id)
+{
+    int target = -1, hit = -1, scan_result = -1;
+    int x, y;
+
+    if (g->data.enemies_count == 0) {
+        game_MESSAGE(g, "No enemies to target.\n");
+        return false;
+    }
+
+    if ((target = data_enemy_by_id(&g->data, target_id)) == -1) {
+        game_MESSAGE(g, "Aborting attack.\n");
+        return false;
+    }
+
+    x = g->data.enemies.x[target];
+    y = g->data.enemies.y[target];
+    scan_result = scan_line_visibility(
+            g->data.player.x, g->data.player.y, x, y, &g->data);
+    hit = scan_result - 1;
+
+    if (scan_result == 0) {
+        game_MESSAGE(g, "Nothing hit.\n");
+        return false;
+
+    } else if (scan_result == FAKE_ASTEROID_INDEX) {
+        game_MESSAGE(g, "Obstacle hit.\n");
+        return false;
+
+    } else if (scan_result == FAKE_PLAYER_INDEX) {
+        fprintf(stderr, "ERROR: Player hit player - this shouldn't happen.\n");
+        exit(1);
+    } else if (hit == target) {
+        game_MESSAGE(g, "Target hit.\n");
+        game_hit_enemy(g, hit);
+        return true;
+
+    } else {
+        game_MESSAGE(g, "Another one hit.\n");
+        game_hit_enemy(g, hit);
+        return true;
+    }
+}
+
+/*
+ * Enemy turns are taken in two phases. First all the enemies decide what
+ * to do, in parallel, looking only at the state left by the previous turn.
+ * Then the decisions are applied serially in index order: when several
+ * enemies try to enter the same field, the one with the lowest index gets
+ * there and the others are blocked, whatever the number of threads.
+ * Hunting enemies walk down a distance field rooted at the player, which
+ * is flooded at most once per turn and only after the player has moved.
+ * With the hierarchical planner they walk their own paths instead, which
+ * are searched again once the player has left their end. In the repair
+ * mode those paths follow the player's steps without any search, until
+ * they may have become too long.
+ */
+
+static void game_targets_SCAN(void *context, int worker, int begin, int end)
+{
+    struct Game *g = context;
+
+    (void)worker;
+
+    scan_visibility_fan(&g->data, g->data.player.x, g->data.player.y,
+            g->data.enemies.x + begin, g->data.enemies.y + begin, end - begin,
+            g->turn.hit + begin);
+}
+
+int game_find_targets(struct Game *g)
+{
+    int i, count = 0;
+
+    turn_reserve(g, g->data.enemies_capacity);
+    game_RUN(g, game_targets_SCAN);
+
+    for (i = 0; i < g->data.enemies_count; ++i) {
+        count += g->turn.hit[i] == i + 1;
+    }
+    return count;
+}
+
+/** @brief Fires the laser at the nearest enemy in the line of fire. */
+static bool game_fire_auto(struct Game *g)
+{
+    int i, dx, dy, distance, best = -1, best_distance = INT_MAX;
+
+    if (game_find_targets(g) == 0) {
+        game_MESSAGE(g, "No enemy in the line of fire.\n");
+        return false;
+    }
+
+    for (i = 0; i < g->data.enemies_count; ++i) {
+        dx = g->data.enemies.x[i] - g->data.player.x;
+        dy = g->data.enemies.y[i] - g->data.player.y;
+        distance = dx * dx + dy * dy;
+        if (g->turn.hit[i] == i + 1 && distance < best_distance) {
+            best = i;
+            best_distance = distance;
+        }
+    }
+
+    return game_fire_laser(g, g->data.enemies.id[best]);
+}
+
+static void game_enemy_idle(struct Game *g, int index)
+{
+    struct Rng rng;
+
+    if (g->turn.sees[index]) {
+        // Atack and begin hunt.
+        g->turn.action[index] = EA_HUNT;
+    } else {
+        // Move cluelessly.
+        rng_seed(&rng, g->turn.seed ^ ((uint64_t)g->data.enemies.id[index] *
+                UINT64_C(0x9e3779b97f4a7c15)));
+        g->turn.action[index] = EA_MOVE;
+        g->turn.dx[index] = rng_range(&rng, 0, 2) - 1;
+        g->turn.dy[index] = rng_range(&rng, 0, 2) - 1;
+    }
+}
+
+static void game_enemy_hunt(struct Game *g, int index)
+{
+    if (g->turn.sees[index]) {
+        g->turn.action[index] = EA_SHOOT;
+    } else {
+        g->turn.action[index] = EA_FOLLOW;
+    }
+}
+
+static void game_enemy_DECIDE(void *context, int worker, int begin, int end)
+{
+    struct Game *g = context;
+    int i, id, cell, cached;
+
+    (void)worker;
+
+    for (i = begin; i < end; ++i) {
+        id = g->data.enemies.id[i];
+        cell = g->data.enemies.y[i] * g->data.width + g->data.enemies.x[i];
+        if ((cached = sight_lookup(g->data.sight, id, cell)) != -1) {
+            STATS_ADD(SC_SIGHT_HITS, 1);
+            g->turn.sees[i] = cached;
+        } else {
+            STATS_ADD(SC_SIGHT_MISSES, 1);
+            g->turn.sees[i] = sight_compute(g->data.sight, &g->data, id, cell);
+        }
+
+        switch (g->data.enemies.behavior[i]) {
+        case EB_IDLE:
+            game_enemy_idle(g, i);
+            break;
+        case EB_HUNT:
+            game_enemy_hunt(g, i);
+            break;
+        }
+    }
+}
+
+/* Takes one step down the distance field, or gives up the hunt when the
+ * player cannot be reached. The stored path is only kept while the step
+ * lands on its next field, once the field leads elsewhere it is dropped
+ * rather than left describing a route the enemy no longer takes. */
+static void game_enemy_FOLLOW(struct Game *g, int index)
+{
+    struct Data *d = &g->data;
+    const int x = d->enemies.x[index];
+    const int y = d->enemies.y[index];
+    const int step = d->enemies.hunt_path_step[index];
+    int next;
+
+    path_field_update(g->field, &g->data,
+            g->data.player.y * g->data.width + g->data.player.x);
+    next = path_field_next(g->field, y * g->data.width + x);
+    if (next == -1) {
+        g->data.enemies.behavior[index] = EB_IDLE;
+        return;
+    }
+
+    game_move_enemy(g, index,
+            next % g->data.width - x, next / g->data.width - y);
+    if (d->enemies.y[index] * d->width + d->enemies.x[index] == next) {
+        if (step + 1 < d->enemies.hunt_path_length[index] &&
+            d->enemies.hunt_path[index][step + 1] == next) {
+                ++d->enemies.hunt_path_step[index];
+        } else if (d->enemies.hunt_path_length[index] > 0) {
+            data_enemy_set_path(d, index, NULL, 0);
+        }
+    }
+}
+
+/* Takes one step along the enemy's own path, or gives up the hunt when
+ * the player cannot be reached. The path is searched again when it no
+ * longer leads to the player or its next field got blocked. */
+static void game_enemy_FOLLOW_PATH(struct Game *g, int index)
+{
+    struct Data *d = &g->data;
+    const int cell = d->enemies.y[index] * d->width + d->enemies.x[index];
+    const int player = d->player.y * d->width + d->player.x;
+    int length = d->enemies.hunt_path_length[index];
+    int step = d->enemies.hunt_path_step[index];
+    const int *path = d->enemies.hunt_path[index];
+    int next;
+
+    if (g->config.repair && length > 0 && path[step] == cell &&
+        game_repair_hunt_path(g, index)) {
+            length = d->enemies.hunt_path_length[index];
+            step = d->enemies.hunt_path_step[index];
+            path = d->enemies.hunt_path[index];
+    }
+    if (length == 0 || path[length - 1] != player || path[step] != cell ||
+        (step + 1 < length && data_is_blocked(d,
+                path[step + 1] % d->width, path[step + 1] / d->width))) {
+        game_find_hunt_path(g, index);
+        length = d->enemies.hunt_path_length[index];
+        step = 0;
+        path = d->enemies.hunt_path[index];
+    }
+    if (step + 1 >= length) {
+        d->enemies.behavior[index] = EB_IDLE;
+        return;
+    }
+
+    next = path[step + 1];
+    game_move_enemy(g, index, next % d->width - d->enemies.x[index],
+            next / d->width - d->enemies.y[index]);
+    if (d->enemies.y[index] * d->width + d->enemies.x[index] == next) {
+        ++d->enemies.hunt_path_step[index];
+    }
+}
+
+static void game_enemy_COMMIT(struct Game *g, int index)
+{
+    switch (g->turn.action[index]) {
+    case EA_NONE:
+        break;
+    case EA_MOVE:
+        game_move_enemy(g, index, g->turn.dx[index], g->turn.dy[index]);
+        break;
+    case EA_HUNT:
+        g->data.enemies.behavior[index] = EB_HUNT;
+        game_find_hunt_path(g, index);
+        game_hit_player(g);
+        break;
+    case EA_SHOOT:
+        game_hit_player(g);
+        break;
+    case EA_FOLLOW:
+        if (g->config.planner == HP_HPA || g->config.repair) {
+            game_enemy_FOLLOW_PATH(g, index);
+        } else {
+            game_enemy_FOLLOW(g, index);
+        }
+        break;
+    }
+}
+
+static void game_enemy_turns(struct Game *g)
+{
+    int i;
+    STATS_START(start);
+
+    turn_reserve(g, g->data.enemies_capacity);
+    g->turn.seed = rng_next(&g->data.rng);
+
+    /* In the per-turn mode paths only last one turn: the enemies
+     * following their own paths search them again below, those going
+     * down the distance field need none and go without. */
+    if (pool_get_mode(g->data.paths) == POOL_TURN) {
+        data_reset_paths(&g->data);
+    }
+
+    sight_begin(g->data.sight, &g->data);
+    game_RUN(g, game_enemy_DECIDE);
+    sight_commit(g->data.sight, &g->data);
+
+    for (i = 0; i < g->data.enemies_count; ++i) {
+        game_enemy_COMMIT(g, i);
+    }
+    STATS_STOP(ST_ENEMY_TURNS, start);
+}
+
+/* The match ends once the enemies or the player are gone. */
+static enum game_result game_RESULT(const struct Game *g)
+{
+    if (g->data.enemies_count == 0) {
+        return GR_WON;
+    }
+
+    if (g->data.player.health <= 0.0) {
+        return GR_LOST;
+    }
+
+    return GR_CONTINUE;
+}
+
+enum game_result game_act(struct Game *g, int c, int target)
+{
+    bool fr;
+
+    switch (c) {
+    case 'h':
+        game_move_player(g, -1, 0);
+        break;
+    case 'j':
+        game_move_player(g, 0, 1);
+        break;
+    case 'k':
+        game_move_player(g, 0, -1);
+        break;
+    case 'l':
+        game_move_player(g, 1, 0);
+        break;
+    case 'L':
+        fr = game_fire_laser(g, target);
+        game_MESSAGE(g, "Attack %s!\n", fr ? "success" : "failure");
+        break;
+    case 'A':
+        fr = game_fire_auto(g);
+        game_MESSAGE(g, "Attack %s!\n", fr ? "success" : "failure");
+        break;
+    default:
+        break;
+    }
+
+    return game_RESULT(g);
+}
+
+enum game_result game_tick(struct Game *g)
+{
+    enum game_result result = game_RESULT(g);
+
+    if (result == GR_CONTINUE) {
+        game_enemy_turns(g);
+    }
+    return result;
+}
+
+enum game_result game_turn(struct Game *g, int c, int target)
+{
+    enum game_result result = game_act(g, c, target);
+
+    if (result != GR_CONTINUE) {
+        return result;
+    }
+    return game_tick(g);
+}
+
+enum game_result game_step(struct Game *g, int c, int target)
+{
+    enum game_result result;
+    STATS_START(start);
+
+    result = game_turn(g, c, target);
+    game_plot(g);
+
+    STATS_TURN(start);
+    return result;
+}
@@ -0,0 +1,129 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "data.h"
+
+struct Workers;
+struct PathField;
+struct Hpa;
+
+enum hunt_planner {
+    HP_FIELD,
+    HP_HPA
+};
+
+enum enemy_action {
+    EA_NONE,
+    EA_MOVE,
+    EA_HUNT,
+    EA_SHOOT,
+    EA_FOLLOW
+};
+
+enum game_result {
+    GR_CONTINUE,
+    GR_WON,
+    GR_LOST
+};
+
+/** @brief Receives one formatted message of a game. */
+typedef void (*game_message_func)(void *context, const char *message);
+
+/** @brief Engine settings kept across the maps played by a game. */
+struct GameConfig {
+    enum hunt_planner planner;
+    bool repair;
+    /* Spreads the enemy decisions over threads, NULL to take them on the
+     * calling thread. Not owned by the game. */
+    struct Workers *workers;
+    /* Receives the messages of the game, NULL to drop them. */
+    game_message_func message;
+    void *message_context;
+};
+
+/*
+ * Everything one match needs, so independent games can be played side by
+ * side, each on its own thread. The map and its random generator live in
+ * the data, the rest is the engine's state.
+ */
+struct Game {
+    struct Data data;
+    struct GameConfig config;
+
+    /* Distances to the player, shared by all the hunting enemies, or the
+     * hierarchical planner giving each of them its own path on huge maps. */
+    struct PathField *field;
+    struct Hpa *hpa;
+
+    /* Per-turn enemy decisions, grown with the enemy count. */
+    struct {
+        int capacity;
+        uint64_t seed;
+        bool *sees;
+        enum enemy_action *action;
+        int *dx, *dy;
+        int *hit;
+    } turn;
+};
+
+/** @brief Prepares a game without any map. The maps generated later draw
+  *        from a random generator seeded here, so a game played with the
+  *        same seed and commands always ends the same way.
+  */
+void game_create(struct Game *g, const struct GameConfig *config, uint64_t seed);
+
+/** @brief Generates a new map and the engine state that goes with it. */
+void game_init(struct Game *g, const struct DataConfig *config);
+
+/** @brief Continues the game saved in a snapshot, whose configuration and
+  *        random generator replace the current ones.
+  * @return False if the snapshot could not be read, the game is left
+  *         without a map then.
+  */
+bool game_load(struct Game *g, const char *path);
+
+/** @brief Frees the map and the engine state, keeping the settings and
+  *        the random generator for the next game_init.
+  */
+void game_deinit(struct Game *g);
+
+/** @brief Plays only the player's command, for games whose enemies move
+  *        on a clock rather than after every command.
+  * @return Whether the command ended the match.
+  */
+enum game_result game_act(struct Game *g, int c, int target);
+
+/** @brief Plays only the enemy turns, unless the match is already over.
+  * @return Whether the match was over before the enemies moved.
+  */
+enum game_result game_tick(struct Game *g);
+
+/** @brief Plays the player's command and the enemy turns that follow it.
+  * @param g The game to play.
+  * @param c The command key: h, j, k or l to move, L to fire at the
+  *        target, A to fire at the nearest enemy in the line of fire.
+  * @param target The enemy id to fire at with the L command.
+  */
+enum game_result game_turn(struct Game *g, int c, int target);
+
+/** @brief Marks what the player sees in the visible plane and adds it to
+  *        the explored plane.
+  */
+void game_plot(struct Game *g);
+
+/** @brief Plays one turn and plots its outcome, which together make the
+  *        turn latency.
+  */
+enum game_result game_step(struct Game *g, int c, int target);
+
+/** @brief Finds what a laser shot at each enemy would hit first, for all
+  *        the enemies in one parallel pass. The scan_visibility hit values
+  *        are left in turn.hit.
+  * @return The number of enemies a shot at which would hit them.
+  */
+int game_find_targets(struct Game *g);
+
+#endif
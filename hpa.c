@@ -0,0 +1,553 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+
+#include "config.h"
+#include "hpa.h"
+#include "bucket.h"
+#include "stats.h"
+
+/*
+ * Clusters.
+ * =========
+ *
+ * Every side of a cluster gets one entrance in the middle of each run of
+ * fields that are open on both sides of the border. The runs are separated
+ * by blocked fields, so a side holds at most half of its length of them.
+ * The two clusters sharing a border find the same runs, which pairs their
+ * entrances up without storing any links between the clusters.
+ */
+
+#define HPA_SIDE HPA_CLUSTER_SIDE
+#define HPA_NODES_MAX (4 * ((HPA_SIDE + 1) / 2))
+#define HPA_CLOSED -2
+#define HPA_HEAP_INITIAL 1024
+#define HPA_PATH_INITIAL 256
+
+struct HpaCluster {
+    bool built;
+    int count;
+    int cells[HPA_NODES_MAX];
+    int across[HPA_NODES_MAX];
+    int *dist;
+};
+
+struct Hpa {
+    int width, height;
+    int cols, rows;
+    struct HpaCluster *clusters;
+
+    /* Cheapest paths confined to one cluster, in cluster coordinates. */
+    int local_x, local_y, local_w, local_h;
+    int *local_dist;
+    struct BucketQueue local_open;
+    int goal_dist[HPA_NODES_MAX];
+
+    /* Search over the entrances, indexed by cluster * HPA_NODES_MAX + node
+     * and lazily reset with stamps like the field search. */
+    int dst;
+    int *cost;
+    int *key;
+    int *parent;
+    unsigned *stamp_map;
+    unsigned stamp;
+    int *heap_pos;
+    int *heap;
+    int heap_size, heap_capacity;
+
+    int *path;
+    int path_length, path_capacity;
+};
+
+static int *hpa_GROW(int *array, int *capacity, int needed, const char *what)
+{
+    if (needed <= *capacity) {
+        return array;
+    }
+    while (*capacity < needed) {
+        *capacity *= 2;
+    }
+    array = realloc(array, *capacity * sizeof(*array));
+    if (!array) {
+        fprintf(stderr, "ERROR: Failed growing the %s.\n", what);
+        exit(1);
+    }
+    return array;
+}
+
+static int hpa_CLUSTER_OF(const struct Hpa *h, int cell)
+{
+    return (cell / h->width / HPA_SIDE) * h->cols + cell % h->width / HPA_SIDE;
+}
+
+static void hpa_local_VISIT(
+        struct Hpa *h, const struct Data *d, int x, int y, int dist)
+{
+    const int local = y * HPA_SIDE + x;
+
+    if (data_is_blocked(d, h->local_x + x, h->local_y + y)) {
+        return;
+    }
+    dist += data_terrain_cost(d, (h->local_y + y) * h->width + h->local_x + x);
+    if (h->local_dist[local] == -1 || dist < h->local_dist[local]) {
+        h->local_dist[local] = dist;
+        bucket_queue_push(&h->local_open, dist, local);
+    }
+}
+
+/* Measures the costs of reaching the other fields of a cluster from one
+ * of its fields, without leaving the cluster. */
+static void hpa_LOCAL(struct Hpa *h, const struct Data *d, int c, int src)
+{
+    const int *cells;
+    int i, count, cur, x, y, dist, pops = 0;
+
+    h->local_x = c % h->cols * HPA_SIDE;
+    h->local_y = c / h->cols * HPA_SIDE;
+    h->local_w = h->width - h->local_x < HPA_SIDE ?
+            h->width - h->local_x : HPA_SIDE;
+    h->local_h = h->height - h->local_y < HPA_SIDE ?
+            h->height - h->local_y : HPA_SIDE;
+
+    memset(h->local_dist, -1, HPA_SIDE * HPA_SIDE * sizeof(*h->local_dist));
+    cur = (src / h->width - h->local_y) * HPA_SIDE +
+          src % h->width - h->local_x;
+    h->local_dist[cur] = 0;
+    bucket_queue_reset(&h->local_open, 0);
+    bucket_queue_push(&h->local_open, 0, cur);
+
+    while (!bucket_queue_empty(&h->local_open)) {
+        count = bucket_queue_take(&h->local_open, &cells, &dist);
+        for (i = 0; i < count; ++i) {
+            cur = cells[i];
+            if (dist != h->local_dist[cur]) {
+                continue;
+            }
+            ++pops;
+            x = cur % HPA_SIDE;
+            y = cur / HPA_SIDE;
+
+            if (x > 0) {
+                hpa_local_VISIT(h, d, x - 1, y, dist);
+            }
+            if (x < h->local_w - 1) {
+                hpa_local_VISIT(h, d, x + 1, y, dist);
+            }
+            if (y > 0) {
+                hpa_local_VISIT(h, d, x, y - 1, dist);
+            }
+            if (y < h->local_h - 1) {
+                hpa_local_VISIT(h, d, x, y + 1, dist);
+            }
+        }
+    }
+    STATS_ADD(SC_PATH_RELAXES, pops);
+}
+
+/* Returns the distance of a field of the last locally searched cluster. */
+static int hpa_LOCAL_AT(const struct Hpa *h, int cell)
+{
+    return h->local_dist[(cell / h->width - h->local_y) * HPA_SIDE +
+                         cell % h->width - h->local_x];
+}
+
+/* Walks one side of a cluster from (x, y) in steps of (sx, sy), looking
+ * across the border by (ox, oy). */
+static void hpa_build_SIDE(
+        struct Hpa *h, const struct Data *d, struct HpaCluster *cl,
+        int x, int y, int sx, int sy, int length, int ox, int oy)
+{
+    int i, mid, run = 0;
+    bool open;
+
+    for (i = 0; i <= length; ++i) {
+        open = i < length &&
+               !data_is_blocked(d, x + i * sx, y + i * sy) &&
+               !data_is_blocked(d, x + i * sx + ox, y + i * sy + oy);
+        if (open) {
+            ++run;
+        } else if (run > 0) {
+            mid = i - 1 - (run - 1) / 2;
+            cl->cells[cl->count] = (y + mid * sy) * h->width + x + mid * sx;
+            cl->across[cl->count] = cl->cells[cl->count] + oy * h->width + ox;
+            ++cl->count;
+            run = 0;
+        }
+    }
+}
+
+/* Returns a cluster, finding its entrances and the distances between them
+ * the first time a search reaches it. */
+static struct HpaCluster *hpa_CLUSTER(
+        struct Hpa *h, const struct Data *d, int c)
+{
+    struct HpaCluster *cl = &h->clusters[c];
+    const int x = c % h->cols * HPA_SIDE;
+    const int y = c / h->cols * HPA_SIDE;
+    const int w = h->width - x < HPA_SIDE ? h->width - x : HPA_SIDE;
+    const int ht = h->height - y < HPA_SIDE ? h->height - y : HPA_SIDE;
+    int i, j;
+
+    if (cl->built) {
+        return cl;
+    }
+
+    cl->count = 0;
+    if (y > 0) {
+        hpa_build_SIDE(h, d, cl, x, y, 1, 0, w, 0, -1);
+    }
+    if (y + ht < h->height) {
+        hpa_build_SIDE(h, d, cl, x, y + ht - 1, 1, 0, w, 0, 1);
+    }
+    if (x > 0) {
+        hpa_build_SIDE(h, d, cl, x, y, 0, 1, ht, -1, 0);
+    }
+    if (x + w < h->width) {
+        hpa_build_SIDE(h, d, cl, x + w - 1, y, 0, 1, ht, 1, 0);
+    }
+
+    free(cl->dist);
+    cl->dist = data_alloc(cl->count * cl->count * sizeof(*cl->dist));
+    for (i = 0; i < cl->count; ++i) {
+        hpa_LOCAL(h, d, c, cl->cells[i]);
+        for (j = 0; j < cl->count; ++j) {
+            cl->dist[i * cl->count + j] = hpa_LOCAL_AT(h, cl->cells[j]);
+        }
+    }
+
+    cl->built = true;
+    return cl;
+}
+
+/* Returns the entrance paired with an entrance of a cluster across its
+ * border, building the neighbouring cluster if needed. */
+static int hpa_PARTNER(struct Hpa *h, const struct Data *d, int c, int k)
+{
+    const int cell = h->clusters[c].cells[k];
+    const int across = h->clusters[c].across[k];
+    const int nc = hpa_CLUSTER_OF(h, across);
+    const struct HpaCluster *other = hpa_CLUSTER(h, d, nc);
+    int j;
+
+    for (j = 0; j < other->count; ++j) {
+        if (other->cells[j] == across && other->across[j] == cell) {
+            return nc * HPA_NODES_MAX + j;
+        }
+    }
+    return -1;
+}
+
+struct Hpa *hpa_create(int width, int height)
+{
+    struct Hpa *h = data_alloc(sizeof(*h));
+    size_t i, count, nodes;
+
+    h->width = width;
+    h->height = height;
+    h->cols = (width + HPA_SIDE - 1) / HPA_SIDE;
+    h->rows = (height + HPA_SIDE - 1) / HPA_SIDE;
+    count = (size_t)h->cols * h->rows;
+    nodes = count * HPA_NODES_MAX;
+
+    h->clusters = data_alloc(count * sizeof(*h->clusters));
+    for (i = 0; i < count; ++i) {
+        h->clusters[i].built = false;
+        h->clusters[i].count = 0;
+        h->clusters[i].dist = NULL;
+    }
+
+    h->local_dist = data_alloc(HPA_SIDE * HPA_SIDE * sizeof(*h->local_dist));
+    bucket_queue_init(&h->local_open, TERRAIN_COST_MAX + 1);
+
+    h->cost = data_alloc(nodes * sizeof(*h->cost));
+    h->key = data_alloc(nodes * sizeof(*h->key));
+    h->parent = data_alloc(nodes * sizeof(*h->parent));
+    h->heap_pos = data_alloc(nodes * sizeof(*h->heap_pos));
+    h->stamp_map = data_alloc(nodes * sizeof(*h->stamp_map));
+    memset(h->stamp_map, 0, nodes * sizeof(*h->stamp_map));
+    h->stamp = 0;
+
+    h->heap_capacity = HPA_HEAP_INITIAL;
+    h->heap = malloc(h->heap_capacity * sizeof(*h->heap));
+    h->heap_size = 0;
+    h->path_capacity = HPA_PATH_INITIAL;
+    h->path = malloc(h->path_capacity * sizeof(*h->path));
+    h->path_length = 0;
+    if (!h->heap || !h->path) {
+        fprintf(stderr, "ERROR: Failed allocating the hierarchical planner.\n");
+        exit(1);
+    }
+
+    return h;
+}
+
+void hpa_destroy(struct Hpa *h)
+{
+    int i;
+
+    if (h == NULL) {
+        return;
+    }
+    for (i = 0; i < h->cols * h->rows; ++i) {
+        free(h->clusters[i].dist);
+    }
+    free(h->clusters);
+    free(h->local_dist);
+    bucket_queue_free(&h->local_open);
+    free(h->cost);
+    free(h->key);
+    free(h->parent);
+    free(h->heap_pos);
+    free(h->stamp_map);
+    free(h->heap);
+    free(h->path);
+    free(h);
+}
+
+/*
+ * Binary heap of open entrances ordered by key, ties broken in favour
+ * of the entrance further from the source.
+ * ===================================================================
+ */
+
+static bool hpa_heap_LESS(const struct Hpa *h, int a, int b)
+{
+    if (h->key[a] != h->key[b]) {
+        return h->key[a] < h->key[b];
+    }
+    return h->cost[a] > h->cost[b];
+}
+
+static void hpa_heap_PLACE(struct Hpa *h, int pos, int node)
+{
+    h->heap[pos] = node;
+    h->heap_pos[node] = pos;
+}
+
+static void hpa_heap_UP(struct Hpa *h, int pos)
+{
+    const int node = h->heap[pos];
+    while (pos > 0) {
+        const int parent = (pos - 1) / 2;
+        if (!hpa_heap_LESS(h, node, h->heap[parent])) {
+            break;
+        }
+        hpa_heap_PLACE(h, pos, h->heap[parent]);
+        pos = parent;
+    }
+    hpa_heap_PLACE(h, pos, node);
+}
+
+static void hpa_heap_DOWN(struct Hpa *h, int pos)
+{
+    const int node = h->heap[pos];
+    for (;;) {
+        int child = 2 * pos + 1;
+        if (child >= h->heap_size) {
+            break;
+        }
+        if (child + 1 < h->heap_size &&
+            hpa_heap_LESS(h, h->heap[child + 1], h->heap[child])) {
+                ++child;
+        }
+        if (!hpa_heap_LESS(h, h->heap[child], node)) {
+            break;
+        }
+        hpa_heap_PLACE(h, pos, h->heap[child]);
+        pos = child;
+    }
+    hpa_heap_PLACE(h, pos, node);
+}
+
+static int hpa_heap_POP(struct Hpa *h)
+{
+    const int top = h->heap[0];
+    h->heap_pos[top] = -1;
+    if (--h->heap_size > 0) {
+        hpa_heap_PLACE(h, 0, h->heap[h->heap_size]);
+        hpa_heap_DOWN(h, 0);
+    }
+    return top;
+}
+
+/*
+ * Search.
+ * =======
+ */
+
+static int hpa_CELL(const struct Hpa *h, int node)
+{
+    return h->clusters[node / HPA_NODES_MAX].cells[node % HPA_NODES_MAX];
+}
+
+static void hpa_RELAX(struct Hpa *h, int src, int next, int next_cost)
+{
+    const int cell = hpa_CELL(h, next);
+
+    STATS_ADD(SC_PATH_RELAXES, 1);
+    if (h->stamp_map[next] != h->stamp) {
+        h->stamp_map[next] = h->stamp;
+        h->cost[next] = INT_MAX;
+        h->heap_pos[next] = -1;
+    }
+    if (h->heap_pos[next] == HPA_CLOSED || next_cost >= h->cost[next]) {
+        return;
+    }
+
+    h->cost[next] = next_cost;
+    h->key[next] = next_cost + abs(cell % h->width - h->dst % h->width) +
+                               abs(cell / h->width - h->dst / h->width);
+    h->parent[next] = src;
+    if (h->heap_pos[next] == -1) {
+        h->heap = hpa_GROW(h->heap, &h->heap_capacity, h->heap_size + 1,
+                "hierarchical path heap");
+        hpa_heap_PLACE(h, h->heap_size++, next);
+    }
+    hpa_heap_UP(h, h->heap_pos[next]);
+}
+
+static void hpa_APPEND(struct Hpa *h, int cell)
+{
+    h->path = hpa_GROW(h->path, &h->path_capacity, h->path_length + 1,
+            "hierarchical path");
+    h->path[h->path_length++] = cell;
+}
+
+/* Appends the cheapest walk inside a cluster from one field to another,
+ * leaving out the first one. The costs are measured from the far end, so
+ * each step back towards it sheds the cost of the field it leaves. */
+static void hpa_SEGMENT(
+        struct Hpa *h, const struct Data *d, int c, int from, int to)
+{
+    int cur = from, dist, x, y;
+
+    hpa_LOCAL(h, d, c, to);
+    while (cur != to) {
+        dist = hpa_LOCAL_AT(h, cur) - data_terrain_cost(d, cur);
+        x = cur % h->width - h->local_x;
+        y = cur / h->width - h->local_y;
+        if (x > 0 && hpa_LOCAL_AT(h, cur - 1) == dist) {
+            cur -= 1;
+        } else if (x < h->local_w - 1 && hpa_LOCAL_AT(h, cur + 1) == dist) {
+            cur += 1;
+        } else if (y > 0 && hpa_LOCAL_AT(h, cur - h->width) == dist) {
+            cur -= h->width;
+        } else {
+            cur += h->width;
+        }
+        hpa_APPEND(h, cur);
+    }
+}
+
+/* Turns the chain of entrances ending in the given one into fields. The
+ * chain is reversed in place in the heap, which the search left empty. */
+static int hpa_REFINE(
+        struct Hpa *h, const struct Data *d, int src, int dst, int last)
+{
+    int i, count = 0, node, c, cell, prev_c, prev_cell;
+
+    for (node = last; node != -1; node = h->parent[node]) {
+        h->heap = hpa_GROW(h->heap, &h->heap_capacity, count + 1,
+                "hierarchical path heap");
+        h->heap[count++] = node;
+    }
+
+    h->path_length = 0;
+    hpa_APPEND(h, src);
+    prev_c = hpa_CLUSTER_OF(h, src);
+    prev_cell = src;
+    for (i = count - 1; i >= 0; --i) {
+        c = h->heap[i] / HPA_NODES_MAX;
+        cell = hpa_CELL(h, h->heap[i]);
+        if (c == prev_c) {
+            hpa_SEGMENT(h, d, c, prev_cell, cell);
+        } else {
+            hpa_APPEND(h, cell);
+        }
+        prev_c = c;
+        prev_cell = cell;
+    }
+    hpa_SEGMENT(h, d, prev_c, prev_cell, dst);
+
+    return h->path_length;
+}
+
+int hpa_find(struct Hpa *h, const struct Data *d, int src, int dst)
+{
+    const int src_c = hpa_CLUSTER_OF(h, src);
+    const int dst_c = hpa_CLUSTER_OF(h, dst);
+    const struct HpaCluster *start = hpa_CLUSTER(h, d, src_c);
+    const struct HpaCluster *goal = hpa_CLUSTER(h, d, dst_c);
+    const struct HpaCluster *cl;
+    int best = INT_MAX, best_node = -1;
+    int cur, c, k, j, dist, partner;
+
+    if (++h->stamp == 0) {
+        memset(h->stamp_map, 0, (size_t)h->cols * h->rows * HPA_NODES_MAX *
+                sizeof(*h->stamp_map));
+        h->stamp = 1;
+    }
+    h->dst = dst;
+    h->heap_size = 0;
+
+    /* The source and the destination join the graph through the
+     * entrances of their clusters, or directly when they share one. */
+    hpa_LOCAL(h, d, src_c, src);
+    if (src_c == dst_c && hpa_LOCAL_AT(h, dst) != -1) {
+        best = hpa_LOCAL_AT(h, dst);
+    }
+    for (k = 0; k < start->count; ++k) {
+        if ((dist = hpa_LOCAL_AT(h, start->cells[k])) != -1) {
+            hpa_RELAX(h, -1, src_c * HPA_NODES_MAX + k, dist);
+        }
+    }
+    /* Measured from the destination, the cost of a walk includes its
+     * first field instead of its last one. */
+    hpa_LOCAL(h, d, dst_c, dst);
+    for (k = 0; k < goal->count; ++k) {
+        if ((dist = hpa_LOCAL_AT(h, goal->cells[k])) != -1) {
+            dist += data_terrain_cost(d, dst) -
+                    data_terrain_cost(d, goal->cells[k]);
+        }
+        h->goal_dist[k] = dist;
+    }
+
+    while (h->heap_size > 0 && h->key[h->heap[0]] < best) {
+
+        cur = hpa_heap_POP(h);
+        h->heap_pos[cur] = HPA_CLOSED;
+        STATS_ADD(SC_PATH_POPS, 1);
+
+        c = cur / HPA_NODES_MAX;
+        k = cur % HPA_NODES_MAX;
+        cl = &h->clusters[c];
+
+        if (c == dst_c && h->goal_dist[k] != -1 &&
+            h->cost[cur] + h->goal_dist[k] < best) {
+                best = h->cost[cur] + h->goal_dist[k];
+                best_node = cur;
+        }
+        for (j = 0; j < cl->count; ++j) {
+            dist = cl->dist[k * cl->count + j];
+            if (j != k && dist != -1) {
+                hpa_RELAX(h, cur, c * HPA_NODES_MAX + j, h->cost[cur] + dist);
+            }
+        }
+        if ((partner = hpa_PARTNER(h, d, c, k)) != -1) {
+            hpa_RELAX(h, cur, partner, h->cost[cur] +
+                    data_terrain_cost(d, hpa_CELL(h, partner)));
+        }
+    }
+
+    if (best == INT_MAX) {
+        h->path_length = 0;
+        return -1;
+    }
+    return hpa_REFINE(h, d, src, dst, best_node);
+}
+
+const int *hpa_path(const struct Hpa *h)
+{
+    return h->path;
+}
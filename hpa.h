@@ -0,0 +1,38 @@
+#ifndef HPA_H
+#define HPA_H
+
+#include "data.h"
+
+struct Hpa;
+
+/** @brief Allocates a hierarchical path planner for maps of the given size.
+  *        The map is split into square clusters connected through the
+  *        entrances on their borders. A cluster's entrances and the
+  *        distances between them are only built when a search first
+  *        crosses it and are never rebuilt: the asteroids and the terrain
+  *        of a map do not change once it is generated or loaded, and each
+  *        new map gets a new planner. Enemies do not block the planner,
+  *        they settle who takes a field when they move.
+  */
+struct Hpa *hpa_create(int width, int height);
+void hpa_destroy(struct Hpa *h);
+
+/** @brief Finds a path between two map cells, going around the asteroids.
+  *        The entrance graph is searched with A* and the abstract path
+  *        is refined into fields cluster by cluster, so the result is
+  *        near-optimal rather than shortest.
+  * @param h The planner to use.
+  * @param d The data in which the search is performed.
+  * @param src The index of the source field.
+  * @param dst The index of the destination field.
+  * @return The number of fields on the path including both ends,
+  *         -1 if the destination is unreachable.
+  */
+int hpa_find(struct Hpa *h, const struct Data *d, int src, int dst);
+
+/** @brief Returns the fields of the last found path, from the source to
+  *        the destination. Valid until the next hpa_find.
+  */
+const int *hpa_path(const struct Hpa *h);
+
+#endif
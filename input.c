@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "input.h"
+
+#define INPUT_BUFFER 256
+
+static struct {
+    bool raw;
+    struct termios saved;
+    char buffer[INPUT_BUFFER];
+    size_t head, tail;
+} input;
+
+static const int input_signals[] = { SIGINT, SIGTERM, SIGHUP, SIGQUIT };
+
+/* Restores the terminal and lets the signal do what it would have done. */
+static void input_SIGNAL(int sig)
+{
+    if (input.raw) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &input.saved);
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+void input_open(void)
+{
+    struct termios raw;
+    size_t i;
+
+    if (input.raw || !isatty(STDIN_FILENO) ||
+        tcgetattr(STDIN_FILENO, &input.saved) == -1) {
+        return;
+    }
+
+    raw = input.saved;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) == -1) {
+        return;
+    }
+    input.raw = true;
+
+    atexit(input_close);
+    for (i = 0; i < sizeof(input_signals) / sizeof(*input_signals); ++i) {
+        signal(input_signals[i], input_SIGNAL);
+    }
+}
+
+void input_close(void)
+{
+    if (input.raw) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &input.saved);
+        input.raw = false;
+    }
+}
+
+/* Waits for input, or for the other descriptor to become readable, and
+ * reads everything available at once.
+ * @return 1 if keys were read, 0 if only the other descriptor is ready,
+ *         EOF at the end of the input. */
+static int input_FILL(int other)
+{
+    struct pollfd pfds[2];
+    ssize_t result;
+
+    pfds[0].fd = STDIN_FILENO;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = other;
+    pfds[1].events = POLLIN;
+
+    for (;;) {
+        if (poll(pfds, other < 0 ? 1 : 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return EOF;
+        }
+        if (pfds[0].revents == 0) {
+            return 0;
+        }
+        result = read(STDIN_FILENO, input.buffer, sizeof(input.buffer));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return EOF;
+        }
+        input.head = 0;
+        input.tail = result;
+        return 1;
+    }
+}
+
+int input_getch(void)
+{
+    if (input.head == input.tail && input_FILL(-1) != 1) {
+        return EOF;
+    }
+    return (unsigned char)input.buffer[input.head++];
+}
+
+size_t input_pending(void)
+{
+    return input.tail - input.head;
+}
+
+int input_wait(int fd)
+{
+    int result;
+
+    if (input.head != input.tail) {
+        return input_pending();
+    }
+    if ((result = input_FILL(fd)) != 1) {
+        return result;
+    }
+    return input_pending();
+}
+
+int input_read_line(char *line, size_t size)
+{
+    size_t length = 0;
+    int c;
+
+    fflush(stdout);
+    while ((c = input_getch()) != '\n' && c != '\r') {
+        if (c == EOF) {
+            line[length] = '\0';
+            return -1;
+        }
+        if ((c == '\b' || c == 0x7f) && length > 0) {
+            --length;
+            if (input.raw) {
+                fputs("\b \b", stdout);
+            }
+        } else if (c >= ' ' && c < 0x7f && length + 1 < size) {
+            line[length++] = c;
+            if (input.raw) {
+                putchar(c);
+            }
+        }
+        fflush(stdout);
+    }
+    line[length] = '\0';
+    return length;
+}
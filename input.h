@@ -0,0 +1,41 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stddef.h>
+
+/*
+ * Keyboard input. The terminal is switched to raw mode once and restored
+ * on exit or on a fatal signal. Keys are read in bulk whenever poll
+ * reports input, so bursts of keys cost one read.
+ */
+
+/** @brief Switches standard input to raw mode if it is a terminal. */
+void input_open(void);
+
+/** @brief Restores the terminal mode saved by input_open. */
+void input_close(void);
+
+/** @brief Returns the next key, waiting for one if none is queued.
+  * @return The key, EOF at the end of the input.
+  */
+int input_getch(void);
+
+/** @brief Returns the number of keys already queued. */
+size_t input_pending(void);
+
+/** @brief Waits until keys are queued or another descriptor, such as a
+  *        timer, becomes readable.
+  * @param fd The other descriptor.
+  * @return The number of keys queued, 0 if only the other descriptor is
+  *         ready, EOF at the end of the input.
+  */
+int input_wait(int fd);
+
+/** @brief Reads a line, echoing it since the terminal does not.
+  * @param[out] line The line, without the line break, always terminated.
+  * @param size The size of the line buffer.
+  * @return The length of the line, -1 at the end of the input.
+  */
+int input_read_line(char *line, size_t size);
+
+#endif
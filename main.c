@@ -1,81 +1,118 @@
 #include <stdio.h>
+#include <stdarg.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
 #include <time.h>
-#include <math.h>
+#include <limits.h>
 #include <unistd.h>
 
 #include "config.h"
-#include "xeno.h"
+#include "input.h"
 #include "data.h"
-#include "scan.h"
+#include "game.h"
+#include "rng.h"
+#include "workers.h"
+#include "screen.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "server.h"
+#include "tick.h"
 
 #define MIN(MACRO_x, MACRO_y) ((MACRO_x) < (MACRO_y) ? (MACRO_x) : (MACRO_y))
 #define MAX(MACRO_x, MACRO_y) ((MACRO_x) > (MACRO_y) ? (MACRO_x) : (MACRO_y))
 
-#define PRINT_HR(MACRO_width)\
-    do {\
-        int MACRO_i;\
-        for (MACRO_i = 0; MACRO_i < (MACRO_width); ++MACRO_i) {\
-            printf("=");\
-        }\
-        printf("\n");\
-    } while(0)
+#define HEADLESS_TURNS 1000
+#define STATUS_COLS_MIN 40
+#define STATUS_MESSAGES 4
 
-struct Data data;
+static struct {
+    struct DataConfig data;
+    struct GameConfig game;
+    uint64_t seed;
+    bool seeded;
+    bool headless;
+    long turns;
+    long batch;
+    int rate;
+    const char *policy;
+    int threads;
+    const char *load;
+    const char *save;
+    const char *serve;
+    const char *connect;
+} options;
+
+static struct Workers *workers;
+
+/* The game played in the interactive and the headless modes. */
+static struct Game game;
+
+/* Scratch space for turning the map planes into glyphs. */
+static struct {
+    uint64_t *paths;
+    char *row;
+} glyphs;
 
+/* The interactive terminal and the messages waiting for the next frame. */
+static struct Screen *screen;
 static struct {
-    int pred_map[MAP_WIDTH * MAP_HEIGHT];
-    bool close_map[MAP_WIDTH * MAP_HEIGHT];
-    double cost_map[MAP_WIDTH * MAP_HEIGHT];
-} relax;
+    char text[STATUS_MESSAGES * 80];
+    size_t length;
+} messages;
 
-static void data_init(void)
-{
-    data_init_map(&data);
-    data_init_asteroids(&data);
-    data_init_enemies(&data);
-    data_init_player(&data);
-}
+static void print_message(const char *format, ...);
 
 /*
  * Plotting operations.
  * ====================
  */
 
-static void plot_fog(void)
+static void plot_paths(void)
 {
-    int i;
-    for (i = 0; i < MAP_WIDTH * MAP_HEIGHT; ++i) {
-        if (data.map_buffer[i] == SF_SPACE ||
-            data.map_buffer[i] == SF_PLAYER ||
-            (data.map_buffer[i] >= '0' && data.map_buffer[i] <= '9')) {
-                data.map_buffer[i] = SF_FOG;
+    int e, i;
+    memset(glyphs.paths, 0,
+            data_plane_words(&game.data) * sizeof(*glyphs.paths));
+    for (e = 0; e < game.data.enemies_count; ++e) {
+        for (i = game.data.enemies.hunt_path_step[e];
+                i < game.data.enemies.hunt_path_length[e]; ++i) {
+            data_plane_set(glyphs.paths, game.data.enemies.hunt_path[e][i]);
         }
     }
 }
 
-static void plot_map(void)
+static char plot_GLYPH(int cell)
 {
-    int x, y;
-    for (x = 0; x < MAP_WIDTH; ++x) {
-        for (y = 0; y < MAP_HEIGHT; ++y) {
-            scan_generic(data.player.x, data.player.y, x, y, &data, scan_plot);
+    if (data_plane_get(game.data.visible, cell)) {
+        if (cell == game.data.player.y * game.data.width + game.data.player.x) {
+            return SF_PLAYER;
+        } else if (data_plane_get(game.data.blocked, cell)) {
+            return SF_ASTEROID;
+        } else if (data_plane_get(game.data.occupied, cell)) {
+            return '0' + game.data.enemies.id[game.data.enemy_map[cell]] % 10;
+        } else if (data_terrain_cost(&game.data, cell) > 1) {
+            return SF_ROUGH;
         }
+        return SF_SPACE;
+    } else if (data_plane_get(glyphs.paths, cell)) {
+        return SF_PATH;
+    } else if (!data_plane_get(game.data.explored, cell)) {
+        return SF_UNSCANNED;
+    } else if (data_plane_get(game.data.blocked, cell)) {
+        return SF_ASTEROID;
     }
-    data.map_buffer[data.player.y * MAP_WIDTH + data.player.x] = SF_PLAYER;
+    return SF_FOG;
 }
 
-static void plot_paths(void)
+/** @brief Turns one row of the map planes into glyphs. */
+static const char *plot_row(int y)
 {
-    int e, i;
-    for (e = 0; e < data.enemies_count; ++e) {
-        for (i = 0; i < data.enemies[e].hunt_path_length; ++i) {
-            int step = data.enemies[e].hunt_path[i];
-            data.map_buffer[step] = SF_PATH;
-        }
+    int x;
+    for (x = 0; x < game.data.width; ++x) {
+        glyphs.row[x] = plot_GLYPH(y * game.data.width + x);
     }
+    return glyphs.row;
 }
 
 /*
@@ -83,372 +120,828 @@ static void plot_paths(void)
  * ===================
  */
 
+static void print_usage(const char *program)
+{
+    printf("Usage: %s [options]\n", program);
+    printf("  -w WIDTH      Map width [%d-%d] (default %d)\n",
+            MAP_SIDE_MIN, MAP_SIDE_MAX, MAP_WIDTH);
+    printf("  -h HEIGHT     Map height [%d-%d] (default %d)\n",
+            MAP_SIDE_MIN, MAP_SIDE_MAX, MAP_HEIGHT);
+    printf("  -a MIN:MAX    Asteroid count range (default %d:%d)\n",
+            ASTEROIDS_MIN, ASTEROIDS_MAX);
+    printf("  -s MIN:MAX    Asteroid side range (default %d:%d)\n",
+            ASTEROID_SIDE_MIN, ASTEROID_SIDE_MAX);
+    printf("  -e MIN:MAX    Enemy count range (default %d:%d)\n",
+            ENEMIES_MIN, ENEMIES_MAX);
+    printf("  -n MIN:MAX    Nebula count range, nebulae cost %d per step to\n"
+           "                cross (default %d:%d)\n",
+            NEBULA_COST, NEBULAE_MIN, NEBULAE_MAX);
+    printf("  -g COST       Cost of a step next to an asteroid [1-%d]\n"
+           "                (default %d)\n", TERRAIN_COST_MAX, MARGIN_COST);
+    printf("  -r SEED       Random seed (default: current time)\n");
+    printf("  -H            Run headless, without terminal input or output\n");
+    printf("  -t TURNS      Number of headless turns (default %d)\n",
+            HEADLESS_TURNS);
+    printf("  -j THREADS    Threads for the enemy turns (default: all cores)\n");
+    printf("  -m MODE       Hunt path memory: \"keep\" reuses freed paths,\n"
+           "                \"turn\" frees them all every turn, enemies going\n"
+           "                down the field then hunt without one\n"
+           "                (default keep)\n");
+    printf("  -P PLANNER    Hunt paths: \"field\" floods the map from the\n"
+           "                player, \"hpa\" searches a cluster graph for\n"
+           "                each hunter on huge maps (default field)\n");
+    printf("  -T RATE       Move the enemies RATE times a second instead of\n"
+           "                after every key, headless turns wait for the\n"
+           "                ticks too (default: off)\n");
+    printf("  -i            Repair the hunt paths as the player moves instead\n"
+           "                of searching them again every time\n");
+    printf("  -l FILE       Load the game from a snapshot\n");
+    printf("  -o FILE       Save the game into a snapshot on exit\n");
+    printf("  -b MATCHES    Play independent headless matches of up to TURNS\n"
+           "                turns each on all the threads and sum them up\n");
+    printf("  -p POLICY     Headless input: \"random\", a key script like\n"
+           "                \"hhjjL1\" or @FILE with one (default random)\n");
+    printf("  -S SOCKET     Serve a match to every client of a Unix socket,\n"
+           "                spread over THREADS event loops\n");
+    printf("  -C SOCKET     Play on a server, sending the standard input\n"
+           "                lines as commands and printing the replies\n");
+}
+
+/** @brief Queues a message to be shown below the map in the next frame. */
+static void print_message(const char *format, ...)
+{
+    va_list args;
+    int length;
+    const size_t room = sizeof(messages.text) - messages.length;
+
+    if (options.headless) {
+        return;
+    }
+    va_start(args, format);
+    length = vsnprintf(messages.text + messages.length, room, format, args);
+    va_end(args);
+    if (length > 0) {
+        messages.length += (size_t)length < room ? (size_t)length : room - 1;
+    }
+}
+
+/* Shows the messages of the game played in the terminal. */
+static void print_GAME_MESSAGE(void *context, const char *message)
+{
+    (void)context;
+    print_message("%s", message);
+}
+
 static void print_welcome(void)
 {
-    printf("Welcome to the Space Tactical Battle!\n");
+    print_message("Welcome to the Space Tactical Battle!\n");
+}
+
+static void print_line(int row, const char *format, ...)
+{
+    char line[STATUS_COLS_MIN + 1];
+    va_list args;
+    int length;
+
+    va_start(args, format);
+    length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    screen_put(screen, row, 0, line, MIN(length, STATUS_COLS_MIN));
 }
 
 static int print_laser_prompt(void)
 {
-    int scan_result = 0;
-    int target = -1;
+    char line[32], *end;
+    long target;
+    int i;
+
+    if (game_find_targets(&game) > 0) {
+        printf("In the line of fire:");
+        for (i = 0; i < game.data.enemies_count; ++i) {
+            if (game.turn.hit[i] == i + 1) {
+                printf(" %d", game.data.enemies.id[i]);
+            }
+        }
+        printf("\n");
+    }
 
-    while (scan_result != 1) {
-        printf("Fire laser, select target [0-%d] (negative value to cancel): ", data.enemies_count - 1);
-        scan_result = scanf("%d", &target);
+    for (;;) {
+        printf("Fire laser, select target id (negative value to cancel): ");
+        if (input_read_line(line, sizeof(line)) < 0) {
+            return -1;
+        }
         printf("\n");
+        target = strtol(line, &end, 10);
+        if (end == line || *end != '\0') {
+            continue;
+        }
         if (target < 0) {
             return -1;
         }
-        if (target < 0 || target >= data.enemies_count) {
-            scan_result = 0;
+        if (target <= INT_MAX && data_enemy_by_id(&game.data, target) != -1) {
+            return target;
         }
     }
-
-    return target;
 }
 
+/** @brief Renders the status, the plotted map and the queued messages as
+  *        one frame, sending only what changed since the previous frame.
+  */
 static void print_status(void)
 {
-    int i;
+    const int cols = MAX(game.data.width, STATUS_COLS_MIN);
+    const int map_row = 6;
+    const int rows = map_row + game.data.height + 1 + STATUS_MESSAGES;
+    const char *message = messages.text;
+    const char *end = messages.text + messages.length;
+    const char *newline;
+    int i, row;
+    STATS_START(start);
 
-    printf("Tactical status:\n");
-    printf("\n");
+    screen_begin(screen, cols, rows);
 
-    printf("Aseroids: %d\n", data.asteroids_count);
-    printf("Enemies : %d\n", data.enemies_count);
-    printf("\n");
+    print_line(0, "Tactical status:");
+    print_line(2, "Aseroids: %d", game.data.asteroids_count);
+    print_line(3, "Enemies : %d", game.data.enemies_count);
 
-    plot_fog();
     plot_paths();
-    plot_map();
+    screen_fill(screen, map_row - 1, 0, '=', game.data.width);
+    for (i = 0; i < game.data.height; ++i) {
+        screen_put(screen, map_row + i, 0, plot_row(i), game.data.width);
+    }
+    screen_fill(screen, map_row + game.data.height, 0, '=', game.data.width);
 
-    PRINT_HR(MAP_WIDTH);
-    for (i = 0; i < MAP_HEIGHT; ++i) {
-        printf("%.*s\n", MAP_WIDTH, data.map_buffer + (i * MAP_WIDTH));
+    row = map_row + game.data.height + 1;
+    while (message < end && row < rows) {
+        newline = memchr(message, '\n', end - message);
+        if (newline == NULL) {
+            newline = end;
+        }
+        screen_put(screen, row++, 0, message, newline - message);
+        message = newline + 1;
     }
-    PRINT_HR(MAP_WIDTH);
-}
+    messages.length = 0;
 
-/*
- * Game engine.
- * ============
- */
+    fflush(stdout);
+    STATS_ADD(SC_RENDER_BYTES, screen_flush(screen, STDOUT_FILENO));
+    STATS_STOP(ST_RENDER, start);
+}
 
-static void game_set_hunt_path_INIT(int source)
+/* Plays a turn for every key. */
+static enum game_result game_loop_KEYS(void)
 {
-    int i;
-    for (i = 0; i < MAP_WIDTH * MAP_HEIGHT; ++i) {
-        relax.pred_map[i] = i;
-        relax.close_map[i] = false;
-        relax.cost_map[i] = INFINITY;
-    }
+    int c = 0, target;
+    enum game_result result = GR_CONTINUE;
+
+    while (result == GR_CONTINUE && (c = input_getch()) != 'q' && c != EOF) {
+        target = -1;
+        if (c == 'L' && game.data.enemies_count > 0) {
+            print_status();
+            target = print_laser_prompt();
+            screen_invalidate(screen);
+        }
+
+        result = game_step(&game, c, target);
+        STATS_POLL(stderr);
 
-    relax.cost_map[source] = 0;
+        /* The queued keys are played before drawing a frame. */
+        if (result == GR_CONTINUE && input_pending() == 0) {
+            print_status();
+        }
+    }
+    return result;
 }
 
-static int game_set_hunt_path_CHEAPEST(void)
+/* Moves the player as soon as a key arrives and the enemies on the ticks
+ * of the clock, drawing a frame whenever either happened. The clock keeps
+ * running while the laser prompt waits for a target, the ticks missed
+ * meanwhile are partly caught up after it. */
+static enum game_result game_loop_TICKS(void)
 {
-    int i, cheap = -1;
-    double cheap_cost = INFINITY;
-    for (i = 0; i < MAP_WIDTH * MAP_HEIGHT; ++i) {
-        if (relax.close_map[i] == false &&
-            relax.cost_map[i] < cheap_cost) {
-                cheap_cost = relax.cost_map[i];
-                cheap = i;
+    int c = 0, target, due;
+    enum game_result result = GR_CONTINUE;
+    struct Ticker *ticker;
+
+    if ((ticker = ticker_create(options.rate)) == NULL) {
+        fprintf(stderr, "ERROR: Failed starting the tick clock.\n");
+        return GR_CONTINUE;
+    }
+
+    while (result == GR_CONTINUE && c != 'q' &&
+           input_wait(ticker_fd(ticker)) != EOF) {
+        while (result == GR_CONTINUE && input_pending() > 0 &&
+               (c = input_getch()) != 'q') {
+            target = -1;
+            if (c == 'L' && game.data.enemies_count > 0) {
+                print_status();
+                target = print_laser_prompt();
+                screen_invalidate(screen);
+            }
+            result = game_act(&game, c, target);
+        }
+
+        due = ticker_due(ticker, false);
+        for (; result == GR_CONTINUE && due > 0; --due) {
+            ticker_begin(ticker);
+            result = game_tick(&game);
+            ticker_end(ticker);
+        }
+        STATS_POLL(stderr);
+
+        /* One plot per frame, however many ticks were caught up. */
+        game_plot(&game);
+        if (result == GR_CONTINUE) {
+            print_status();
         }
     }
-    return cheap;
+
+    ticker_report(ticker, stderr);
+    ticker_destroy(ticker);
+    return result;
 }
 
-static void game_set_hunt_path_RELAX(int x1, int y1, int x2, int y2)
+static void game_loop(void)
 {
-    const int src = y1 * MAP_WIDTH + x1;
-    const int dst = y2 * MAP_WIDTH + x2;
-    const double src_cost = relax.cost_map[src];
-    const double dst_cost = relax.cost_map[dst];
+    enum game_result result;
 
-    if ((src_cost + 1.0) < dst_cost) {
-        relax.cost_map[dst] = src_cost + 1.0;
-        relax.pred_map[dst] = src;
+    glyphs.paths = data_alloc(
+            data_plane_words(&game.data) * sizeof(*glyphs.paths));
+    glyphs.row = data_alloc(game.data.width);
+
+    input_open();
+    game_plot(&game);
+    print_status();
+    result = options.rate > 0 ? game_loop_TICKS() : game_loop_KEYS();
+    if (result != GR_CONTINUE) {
+        print_status();
+        printf(result == GR_WON ? "You are awesome!\n" : "You failed!\n");
     }
+    input_close();
+
+    free(glyphs.paths);
+    free(glyphs.row);
+    memset(&glyphs, 0, sizeof(glyphs));
 }
 
-static void game_set_hunt_path_BUILD(int index)
+/*
+ * Headless simulation.
+ * ====================
+ */
+
+/* The key script shared by all the headless matches, NULL for random
+ * commands. */
+static struct {
+    char *text;
+    size_t length;
+} script;
+
+/* Where one match is in the script or in its random commands. */
+struct Policy {
+    struct Rng rng;
+    size_t script_pos;
+};
+
+static bool script_load(const char *spec)
 {
-    const int src = data.enemies[index].y * MAP_WIDTH + data.enemies[index].x;
-    const int dst = data.player.y * MAP_WIDTH + data.player.x;
-    int path_length = 0;
-    int write_index = 0;
-    int cur = src;
+    FILE *file;
+    long length;
+
+    script.text = NULL;
+    script.length = 0;
 
-    while (cur != dst) {
-        ++path_length;
-        cur = relax.pred_map[cur];
+    if (spec == NULL || strcmp(spec, "random") == 0) {
+        return true;
     }
-    ++path_length;
 
-    data.enemies[index].hunt_path_length = path_length;
-    data.enemies[index].hunt_path = malloc(
-            path_length * sizeof(*data.enemies[index].hunt_path));
+    if (spec[0] != '@') {
+        script.text = strdup(spec);
+        script.length = strlen(spec);
+        return script.text != NULL && script.length > 0;
+    }
 
-    cur = src;
-    while (cur != dst) {
-        data.enemies[index].hunt_path[write_index++] = cur;
-        cur = relax.pred_map[cur];
+    if ((file = fopen(spec + 1, "rb")) == NULL) {
+        fprintf(stderr, "ERROR: Failed opening script %s.\n", spec + 1);
+        return false;
     }
-    data.enemies[index].hunt_path[write_index++] = cur;
+    fseek(file, 0, SEEK_END);
+    length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (length > 0 && (script.text = malloc(length)) != NULL) {
+        script.length = fread(script.text, 1, length, file);
+    }
+    fclose(file);
 
-    data.enemies[index].hunt_path_step = 0;
+    if (script.length == 0) {
+        fprintf(stderr, "ERROR: Empty script %s.\n", spec + 1);
+        return false;
+    }
+    return true;
 }
 
-static void game_set_hunt_path(int index)
+static void policy_init(struct Policy *p, uint64_t seed)
 {
-    const int px = data.player.x;
-    const int py = data.player.y;
-    const int ex = data.enemies[index].x;
-    const int ey = data.enemies[index].y;
-    const int src = py * MAP_WIDTH + px;
-    const int dst = ey * MAP_WIDTH + ex;
-    int cur, cur_x, cur_y;
-
-    game_set_hunt_path_INIT(src);
-
-    cur = src;
-    cur_x = ex;
-    cur_y = ey;
+    rng_seed(&p->rng, seed ^ UINT64_C(0x5deece66d));
+    p->script_pos = 0;
+}
 
-    while (cur != dst) {
+static int policy_SCRIPT_NEXT(struct Policy *p)
+{
+    const int c = script.text[p->script_pos];
+    p->script_pos = (p->script_pos + 1) % script.length;
+    return c;
+}
 
-        cur = game_set_hunt_path_CHEAPEST();
+/** @brief Chooses the next command for a headless game.
+  * @param p The policy of the game.
+  * @param d The data of the game.
+  * @param[out] target The laser target id if the command fires the laser.
+  * @return The key of the chosen command.
+  */
+static int policy_next(struct Policy *p, const struct Data *d, int *target)
+{
+    static const char moves[] = "hjkl";
+    int c;
 
-        cur_x = cur % MAP_WIDTH;
-        cur_y = cur / MAP_WIDTH;
+    *target = 0;
 
-        if (cur_x> 0) {
-            game_set_hunt_path_RELAX(cur_x, cur_y, cur_x - 1, cur_y);
-        }
-        if (cur_x < (MAP_WIDTH - 1)) {
-            game_set_hunt_path_RELAX(cur_x, cur_y, cur_x + 1, cur_y);
-        }
-        if (cur_y > 0) {
-            game_set_hunt_path_RELAX(cur_x, cur_y, cur_x, cur_y - 1);
-        }
-        if (cur_y < (MAP_HEIGHT - 1)) {
-            game_set_hunt_path_RELAX(cur_x, cur_y, cur_x, cur_y + 1);
+    if (script.text == NULL) {
+        if (d->enemies_count > 0 && rng_range(&p->rng, 0, 8) == 0) {
+            *target = d->enemies.id[rng_range(&p->rng, 0, d->enemies_count)];
+            return 'L';
         }
-
-        relax.close_map[cur] = true;
+        return moves[rng_range(&p->rng, 0, 4)];
     }
 
-    game_set_hunt_path_BUILD(index);
+    c = policy_SCRIPT_NEXT(p);
+    if (c == 'L') {
+        while (p->script_pos != 0 &&
+               script.text[p->script_pos] >= '0' &&
+               script.text[p->script_pos] <= '9') {
+            *target = *target * 10 + policy_SCRIPT_NEXT(p) - '0';
+        }
+    }
+    return c;
 }
 
-static enum move_result game_try_move(int new_x, int new_y)
+static double headless_now(void)
 {
-    const int new_field = data.map_buffer[new_y * MAP_WIDTH + new_x];
-
-    const bool obstacle = new_field == SF_ASTEROID;
-    const bool enemy = (new_field >= '0' && new_field <= '9');
-    const bool player = (new_x == data.player.x && new_y == data.player.y);
-    const bool outside = new_x < 0 || new_x >= MAP_WIDTH ||
-                   new_y < 0 || new_y >= MAP_HEIGHT;
-
-    if (obstacle || outside) {
-        return MR_BLOCK;
-    } else if (enemy || player) {
-        return MR_SHIP;
-    } else {
-        return MR_CLEAR;
-    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
 }
 
-static void game_move_player(int dx, int dy)
+/* With a tick rate every turn waits for a tick of the clock, so the
+ * report shows whether the engine keeps up with that rate. */
+static bool headless_run(void)
 {
-    const int new_x = data.player.x + dx;
-    const int new_y = data.player.y + dy;
-
-    switch (game_try_move(new_x, new_y)) {
-    case MR_CLEAR:
-        data.player.x = new_x;
-        data.player.y = new_y;
-        /* Intentional fall-through! */
-    case MR_BLOCK:
-        break;
-    case MR_SHIP:
-        data.player.health = 0.0;
-        break;
+    long turns = 0, matches = 1, won = 0, lost = 0;
+    int c, target, due = 0;
+    double start, elapsed;
+    enum game_result result;
+    struct Policy policy;
+    struct Ticker *ticker = NULL;
+
+    policy_init(&policy, options.seed);
+    if (options.rate > 0 &&
+        (ticker = ticker_create(options.rate)) == NULL) {
+            fprintf(stderr, "ERROR: Failed starting the tick clock.\n");
+            return false;
+    }
+
+    start = headless_now();
+    game_plot(&game);
+    while (turns < options.turns) {
+        if ((c = policy_next(&policy, &game.data, &target)) == 'q') {
+            break;
+        }
+        ++turns;
+
+        if (ticker != NULL) {
+            if (due == 0) {
+                due = ticker_due(ticker, true);
+            }
+            --due;
+            ticker_begin(ticker);
+        }
+        result = game_step(&game, c, target);
+        if (ticker != NULL) {
+            ticker_end(ticker);
+        }
+        STATS_POLL(stderr);
+        if (result == GR_CONTINUE) {
+            continue;
+        }
+        won += result == GR_WON;
+        lost += result == GR_LOST;
+
+        if (turns < options.turns) {
+            game_deinit(&game);
+            game_init(&game, &options.data);
+            game_plot(&game);
+            ++matches;
+        }
+    }
+    elapsed = headless_now() - start;
+
+    printf("seed %" PRIu64 " turns %ld matches %ld won %ld lost %ld\n",
+            options.seed, turns, matches, won, lost);
+    printf("elapsed %.3fs (%.0f turns/s)\n",
+            elapsed, elapsed > 0.0 ? turns / elapsed : 0.0);
+    if (ticker != NULL) {
+        ticker_report(ticker, stdout);
+        ticker_destroy(ticker);
     }
+    return true;
 }
 
-static void game_move_enemy(int index, int dx, int dy)
+/*
+ * Batch simulation.
+ * =================
+ *
+ * Independent matches played side by side, one per worker at a time, each
+ * in its own game with its enemy turns taken on the worker's thread. The
+ * seed of a match only depends on the batch seed and the match number, so
+ * the totals do not depend on the number of threads.
+ */
+
+struct BatchTotals {
+    long won, lost, unfinished;
+    long turns;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+static void batch_PLAY(void *context, int worker, int begin, int end)
 {
-    const int new_x = data.enemies[index].x + dx;
-    const int new_y = data.enemies[index].y + dy;
-
-    switch (game_try_move(new_x, new_y)) {
-    case MR_CLEAR:
-        data.enemies[index].x = new_x;
-        data.enemies[index].y = new_y;
-        /* Intentional fall-through! */
-    case MR_BLOCK:
-    case MR_SHIP:
-        break;
+    struct BatchTotals *totals = (struct BatchTotals *)context + worker;
+    struct GameConfig config = options.game;
+    struct Game match;
+    struct Policy policy;
+    enum game_result result;
+    uint64_t seed;
+    long turns;
+    int i, c, target;
+
+    config.workers = NULL;
+    config.message = NULL;
+
+    for (i = begin; i < end; ++i) {
+        seed = options.seed ^ ((uint64_t)i * UINT64_C(0x9e3779b97f4a7c15));
+        game_create(&match, &config, seed);
+        game_init(&match, &options.data);
+        policy_init(&policy, seed);
+
+        game_plot(&match);
+        result = GR_CONTINUE;
+        for (turns = 0; turns < options.turns && result == GR_CONTINUE; ) {
+            if ((c = policy_next(&policy, &match.data, &target)) == 'q') {
+                break;
+            }
+            ++turns;
+            result = game_step(&match, c, target);
+        }
+
+        totals->won += result == GR_WON;
+        totals->lost += result == GR_LOST;
+        totals->unfinished += result == GR_CONTINUE;
+        totals->turns += turns;
+        game_deinit(&match);
     }
 }
 
-static void game_hit_enemy(int index)
+static bool batch_run(void)
 {
-    data.enemies[index] = data.enemies[data.enemies_count - 1];
-    --data.enemies_count;
+    const int count = workers_count(workers);
+    struct BatchTotals *totals = data_alloc(count * sizeof(*totals));
+    struct BatchTotals sum;
+    double start, elapsed;
+    int i;
+
+    memset(totals, 0, count * sizeof(*totals));
+    memset(&sum, 0, sizeof(sum));
+
+    start = headless_now();
+    workers_run(workers, options.batch, 1, batch_PLAY, totals);
+    elapsed = headless_now() - start;
+
+    for (i = 0; i < count; ++i) {
+        sum.won += totals[i].won;
+        sum.lost += totals[i].lost;
+        sum.unfinished += totals[i].unfinished;
+        sum.turns += totals[i].turns;
+    }
+    free(totals);
+
+    printf("seed %" PRIu64 " matches %ld won %ld lost %ld unfinished %ld "
+           "turns %ld\n", options.seed, options.batch,
+           sum.won, sum.lost, sum.unfinished, sum.turns);
+    printf("elapsed %.3fs (%.0f matches/s, %.0f turns/s)\n", elapsed,
+            elapsed > 0.0 ? options.batch / elapsed : 0.0,
+            elapsed > 0.0 ? sum.turns / elapsed : 0.0);
+    return true;
 }
 
-static void game_hit_player(void)
+/*
+ * Command line.
+ * =============
+ */
+
+static bool args_parse_int(const char *arg, int *out)
 {
-    data.player.health = 100.0;
+    char *end;
+    long value = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || value < INT_MIN || value > INT_MAX) {
+        return false;
+    }
+    *out = value;
+    return true;
 }
 
-static bool game_fire_laser(void)
+static bool args_parse_range(const char *arg, int *out_min, int *out_max)
 {
-    int target = - 1, hit = -1, scan_result = -1;
-    int x, y;
+    char *end;
+    long min, max;
 
-    if (data.enemies_count == 0) {
-        printf("No enemies to target.\n");
+    min = strtol(arg, &end, 10);
+    if (end == arg || *end != ':') {
         return false;
     }
-
-    if ((target = print_laser_prompt()) == -1) {
-        printf("Aborting attack.\n");
+    arg = end + 1;
+    max = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' ||
+        min < INT_MIN || min > INT_MAX || max < INT_MIN || max > INT_MAX) {
         return false;
     }
 
-    x = data.enemies[target].x;
-    y = data.enemies[target].y;
-    scan_result = scan_generic(data.player.x, data.player.y, x, y, &data, scan_visibility);
-    hit = scan_result - 1;
-
-    if (scan_result == 0) {
-        printf("Nothing hit.\n");
-        return false;
+    *out_min = min;
+    *out_max = max;
+    return true;
+}
 
-    } else if (scan_result == FAKE_ASTEROID_INDEX) {
-        printf("Obstacle hit.\n");
+static bool args_parse_seed(const char *arg, uint64_t *out)
+{
+    char *end;
+    unsigned long long value = strtoull(arg, &end, 0);
+    if (end == arg || *end != '\0') {
         return false;
-
-    } else if (scan_result == FAKE_PLAYER_INDEX) {
-        printf("Player hit player - this shouldn't happen.\n");
-        exit(1);
-    } else if (hit == target) {
-        printf("Target hit.\n");
-        game_hit_enemy(hit);
-        return true;
-
-    } else {
-        printf("Another one hit.\n");
-        game_hit_enemy(hit);
-        return true;
     }
+    *out = value;
+    return true;
 }
 
-static void game_enemy_idle(int index)
+static bool args_parse_turns(const char *arg, long *out)
 {
-    int dx, dy;
-    int scan_result;
-    const int px = data.player.x;
-    const int py = data.player.y;
-    const int ex = data.enemies[index].x;
-    const int ey = data.enemies[index].y;
-
-    scan_result = scan_generic(ex, ey, px, py, &data, scan_visibility);
-
-    if (scan_result == FAKE_PLAYER_INDEX) {
-        // Atack and begin hunt.
-        data.enemies[index].behavior = EB_HUNT;
-        game_set_hunt_path(index);
-        game_hit_player();
-    } else {
-        // Move cluelessly.
-        dx = XENO_rand_range(0, 2) - 1;
-        dy = XENO_rand_range(0, 2) - 1;
-        game_move_enemy(index, dx, dy);
+    char *end;
+    long value = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || value < 0) {
+        return false;
     }
+    *out = value;
+    return true;
 }
 
-static void game_enemy_hunt()
+static bool args_parse_pool_mode(const char *arg, enum pool_mode *out)
 {
-    /* 1. if player spotted : shoot
-     * 2. else set new hunt path and follow it.
-     * 3. If at the end of the hunt path - goto IDLE sate
-     */
+    if (strcmp(arg, "keep") == 0) {
+        *out = POOL_KEEP;
+    } else if (strcmp(arg, "turn") == 0) {
+        *out = POOL_TURN;
+    } else {
+        return false;
+    }
+    return true;
 }
 
-static void game_enemy_turn(int index)
+static bool args_parse_planner(const char *arg, enum hunt_planner *out)
 {
-    switch (data.enemies[index].behavior) {
-    case EB_IDLE:
-        game_enemy_idle(index);
-        break;
-    case EB_HUNT:
-        game_enemy_hunt(index);
-        break;
+    if (strcmp(arg, "field") == 0) {
+        *out = HP_FIELD;
+    } else if (strcmp(arg, "hpa") == 0) {
+        *out = HP_HPA;
+    } else {
+        return false;
     }
+    return true;
 }
 
-static void game_loop(void)
+static bool args_parse(int argc, char *argv[])
 {
-    int c = 0, i;
-    bool fr;
-
-    print_status();
-    while ((c = XENO_getch()) != 'q') {
-        switch (c) {
+    int opt;
+    bool ok;
+    const char *error;
+    struct DataConfig *config = &options.data;
+
+    data_config_default(config);
+    options.seeded = false;
+    options.headless = false;
+    options.turns = HEADLESS_TURNS;
+    options.policy = NULL;
+    options.threads = sysconf(_SC_NPROCESSORS_ONLN);
+    options.load = NULL;
+    options.save = NULL;
+    options.serve = NULL;
+    options.connect = NULL;
+    options.batch = 0;
+    options.rate = 0;
+    options.game.planner = HP_FIELD;
+    options.game.repair = false;
+    options.game.workers = NULL;
+    options.game.message = NULL;
+    options.game.message_context = NULL;
+
+    while ((opt = getopt(argc, argv, "w:h:a:s:e:n:g:r:Ht:T:b:p:j:m:P:il:o:S:C:")) != -1) {
+        switch (opt) {
+        case 'w':
+            ok = args_parse_int(optarg, &config->width);
+            break;
         case 'h':
-            game_move_player(-1, 0);
+            ok = args_parse_int(optarg, &config->height);
+            break;
+        case 'a':
+            ok = args_parse_range(optarg,
+                    &config->asteroids_min, &config->asteroids_max);
+            break;
+        case 's':
+            ok = args_parse_range(optarg,
+                    &config->asteroid_side_min, &config->asteroid_side_max);
+            break;
+        case 'e':
+            ok = args_parse_range(optarg,
+                    &config->enemies_min, &config->enemies_max);
+            break;
+        case 'n':
+            ok = args_parse_range(optarg,
+                    &config->nebulae_min, &config->nebulae_max);
+            break;
+        case 'g':
+            ok = args_parse_int(optarg, &config->margin_cost);
+            break;
+        case 'r':
+            ok = options.seeded = args_parse_seed(optarg, &options.seed);
+            break;
+        case 'H':
+            ok = options.headless = true;
+            break;
+        case 't':
+            ok = args_parse_turns(optarg, &options.turns);
+            break;
+        case 'T':
+            ok = args_parse_int(optarg, &options.rate) &&
+                 options.rate > 0 && options.rate <= TICK_RATE_MAX;
+            break;
+        case 'b':
+            ok = args_parse_turns(optarg, &options.batch) &&
+                 options.batch <= INT_MAX;
+            break;
+        case 'p':
+            options.policy = optarg;
+            ok = true;
             break;
         case 'j':
-            game_move_player(0, 1);
+            ok = args_parse_int(optarg, &options.threads) &&
+                 options.threads > 0;
+            break;
+        case 'm':
+            ok = args_parse_pool_mode(optarg, &config->paths_mode);
+            break;
+        case 'P':
+            ok = args_parse_planner(optarg, &options.game.planner);
             break;
-        case 'k':
-            game_move_player(0, -1);
+        case 'i':
+            ok = options.game.repair = true;
             break;
         case 'l':
-            game_move_player(1, 0);
+            options.load = optarg;
+            ok = true;
             break;
-        case 'L':
-            fr = game_fire_laser();
-            printf("Attack %s!\n", fr ? "success" : "failure");
+        case 'o':
+            options.save = optarg;
+            ok = true;
+            break;
+        case 'S':
+            options.serve = optarg;
+            ok = true;
+            break;
+        case 'C':
+            options.connect = optarg;
+            ok = true;
             break;
         default:
+            ok = false;
             break;
         }
-
-        if (data.enemies_count == 0) {
-            printf("You are awesome!\n");
-            break;
+        if (!ok) {
+            print_usage(argv[0]);
+            return false;
         }
+    }
 
-        if (data.player.health <= 0.0) {
-            printf("You failed!\n");
-            break;
-        }
+    if ((error = data_config_check(config)) != NULL) {
+        fprintf(stderr, "ERROR: %s\n", error);
+        return false;
+    }
+    if (options.batch > 0 && (options.load != NULL || options.save != NULL)) {
+        fprintf(stderr, "ERROR: Batch matches cannot use snapshots.\n");
+        return false;
+    }
+    if (options.rate > 0 && (options.batch > 0 || options.serve != NULL)) {
+        fprintf(stderr, "ERROR: Only a single game can run on the clock.\n");
+        return false;
+    }
+    if (options.serve != NULL && (options.load != NULL ||
+                options.save != NULL || options.headless ||
+                options.batch > 0 || options.connect != NULL)) {
+        fprintf(stderr, "ERROR: A server only plays new matches.\n");
+        return false;
+    }
 
-        for (i = 0; i < data.enemies_count; ++i) {
-            game_enemy_turn(i);
+    if (!options.seeded) {
+        options.seed = time(NULL);
+    }
+
+    return true;
+}
+
+/** @brief Plays the one game of the interactive and the headless modes. */
+static bool main_PLAY(void)
+{
+    bool ok = true;
+
+    options.game.workers = workers;
+    options.game.message = print_GAME_MESSAGE;
+    game_create(&game, &options.game, options.seed);
+
+    if (options.load != NULL) {
+        if (!game_load(&game, options.load)) {
+            return false;
         }
+        options.data = game.data.config;
+    } else {
+        game_init(&game, &options.data);
+    }
 
-        print_status();
+    if (options.headless) {
+        ok = headless_run();
+    } else {
+        screen = screen_create();
+        print_welcome();
+        game_loop();
+        screen_destroy(screen);
+    }
+
+    if (options.save != NULL) {
+        ok = snapshot_save(&game.data, options.save) && ok;
     }
+    game_deinit(&game);
+    return ok;
 }
 
-int main()
+/** @brief Hosts a match for every client until the server is stopped. */
+static bool main_SERVE(void)
 {
-    srand(time(NULL));
+    struct ServerConfig config;
+
+    config.path = options.serve;
+    config.shards = options.threads;
+    config.data = options.data;
+    config.game = options.game;
+    config.seed = options.seed;
+    return server_run(&config);
+}
 
-    data_init();
-    print_welcome();
-    game_loop();
+int main(int argc, char *argv[])
+{
+    bool ok;
 
-    return 0;
-}
+    if (!args_parse(argc, argv)) {
+        return 1;
+    }
+    if (options.connect != NULL) {
+        return server_client(options.connect) ? 0 : 1;
+    }
+
+    if (options.threads < 1) {
+        options.threads = 1;
+    }
+    if ((workers = workers_create(options.threads)) == NULL) {
+        fprintf(stderr, "ERROR: Failed starting %d threads.\n",
+                options.threads);
+        return 1;
+    }
 
+    STATS_INIT();
+    if ((options.headless || options.batch > 0) &&
+        !script_load(options.policy)) {
+            ok = false;
+    } else if (options.batch > 0) {
+        ok = batch_run();
+    } else if (options.serve != NULL) {
+        ok = main_SERVE();
+    } else {
+        ok = main_PLAY();
+    }
+    STATS_REPORT(stderr);
+
+    free(script.text);
+    workers_destroy(workers);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "path.h"
+#include "bucket.h"
+#include "stats.h"
+
+/*
+ * Distance field.
+ * ===============
+ *
+ * The distances are stored in 16 bits when the farthest possible field,
+ * every other field of the map at the highest step cost away, still fits,
+ * and in 32 bits otherwise. Unreachable fields hold all ones either way.
+ */
+
+#define PATH_FAR UINT32_MAX
+
+struct PathField {
+    int width, height;
+    int root;
+    uint16_t *dist16;
+    uint32_t *dist32;
+    /* The step costs of the last update, for walking back to the root. */
+    const uint8_t *terrain;
+    struct BucketQueue open;
+};
+
+static uint32_t path_field_GET(const struct PathField *pf, int cell)
+{
+    if (pf->dist16 != NULL) {
+        return pf->dist16[cell] == UINT16_MAX ? PATH_FAR : pf->dist16[cell];
+    }
+    return pf->dist32[cell];
+}
+
+struct PathField *path_field_create(int width, int height, int cost_max)
+{
+    const size_t size = (size_t)width * height;
+    struct PathField *pf = data_alloc(sizeof(*pf));
+
+    pf->width = width;
+    pf->height = height;
+    pf->root = -1;
+    pf->terrain = NULL;
+    pf->dist16 = NULL;
+    pf->dist32 = NULL;
+    if ((size - 1) * cost_max < UINT16_MAX) {
+        pf->dist16 = data_alloc(size * sizeof(*pf->dist16));
+    } else {
+        pf->dist32 = data_alloc(size * sizeof(*pf->dist32));
+    }
+    bucket_queue_init(&pf->open, cost_max + 1);
+
+    return pf;
+}
+
+void path_field_destroy(struct PathField *pf)
+{
+    if (pf == NULL) {
+        return;
+    }
+    free(pf->dist16);
+    free(pf->dist32);
+    bucket_queue_free(&pf->open);
+    free(pf);
+}
+
+/* Relaxes a neighbour of the field being expanded, in a flood storing
+ * its distances in dist_map. */
+#define PATH_FIELD_VISIT(MACRO_cell)\
+    do {\
+        const int next = (MACRO_cell);\
+        STATS_ADD(SC_PATH_RELAXES, 1);\
+        if (!data_plane_get(blocked, next) &&\
+            (next_dist = dist + terrain[next]) < dist_map[next]) {\
+                dist_map[next] = next_dist;\
+                bucket_queue_push(open, next_dist, next);\
+        }\
+    } while (0)
+
+/* The flood is spelled out for each distance width, keeping the width
+ * checks out of its inner loop. The fields of one distance are expanded
+ * together, so with unit steps the flood is a breadth-first one going
+ * from one ring of fields to the next. */
+#define PATH_FIELD_FLOOD(MACRO_type, MACRO_dist)\
+    do {\
+        MACRO_type *const dist_map = (MACRO_dist);\
+        memset(dist_map, -1, size * sizeof(*dist_map));\
+        dist_map[root] = 0;\
+        bucket_queue_push(open, 0, root);\
+        while (!bucket_queue_empty(open)) {\
+            count = bucket_queue_take(open, &cells, &key);\
+            for (i = 0; i < count; ++i) {\
+                cur = cells[i];\
+                if ((dist = dist_map[cur]) != (uint32_t)key) {\
+                    continue;\
+                }\
+                ++pops;\
+                cur_x = cur % width;\
+                if (cur_x > 0) {\
+                    PATH_FIELD_VISIT(cur - 1);\
+                }\
+                if (cur_x < width - 1) {\
+                    PATH_FIELD_VISIT(cur + 1);\
+                }\
+                if (cur >= width) {\
+                    PATH_FIELD_VISIT(cur - width);\
+                }\
+                if (cur < last_row) {\
+                    PATH_FIELD_VISIT(cur + width);\
+                }\
+            }\
+        }\
+    } while (0)
+
+void path_field_update(struct PathField *pf, const struct Data *d, int root)
+{
+    const size_t size = (size_t)pf->width * pf->height;
+    const int width = pf->width;
+    const int last_row = (int)size - width;
+    const uint64_t *const blocked = d->blocked;
+    const uint8_t *const terrain = d->terrain;
+    struct BucketQueue *const open = &pf->open;
+    const int *cells;
+    int i, count, cur, cur_x, key, pops = 0;
+    uint32_t dist, next_dist;
+
+    if (root == pf->root) {
+        return;
+    }
+    pf->root = root;
+    pf->terrain = d->terrain;
+
+    bucket_queue_reset(open, 0);
+    if (pf->dist16 != NULL) {
+        PATH_FIELD_FLOOD(uint16_t, pf->dist16);
+    } else {
+        PATH_FIELD_FLOOD(uint32_t, pf->dist32);
+    }
+    STATS_ADD(SC_PATH_POPS, pops);
+}
+
+#undef PATH_FIELD_FLOOD
+#undef PATH_FIELD_VISIT
+
+int path_field_distance(const struct PathField *pf, int cell)
+{
+    const uint32_t dist = path_field_GET(pf, cell);
+    return dist == PATH_FAR ? -1 : (int)dist;
+}
+
+int path_field_next(const struct PathField *pf, int cell)
+{
+    const int x = cell % pf->width;
+    const int y = cell / pf->width;
+    const uint32_t dist = path_field_GET(pf, cell);
+    uint32_t prev;
+
+    if (dist == 0 || dist == PATH_FAR) {
+        return -1;
+    }
+    prev = dist - pf->terrain[cell];
+    if (x > 0 && path_field_GET(pf, cell - 1) == prev) {
+        return cell - 1;
+    }
+    if (x < (pf->width - 1) && path_field_GET(pf, cell + 1) == prev) {
+        return cell + 1;
+    }
+    if (y > 0 && path_field_GET(pf, cell - pf->width) == prev) {
+        return cell - pf->width;
+    }
+    if (y < (pf->height - 1) && path_field_GET(pf, cell + pf->width) == prev) {
+        return cell + pf->width;
+    }
+    return -1;
+}
@@ -0,0 +1,38 @@
+#ifndef PATH_H
+#define PATH_H
+
+#include "data.h"
+
+struct PathField;
+
+/** @brief Allocates a distance field for maps of the given size.
+  * @param width The map width.
+  * @param height The map height.
+  * @param cost_max The highest terrain cost on the map, which decides
+  *        whether the distances fit in 16 bits.
+  */
+struct PathField *path_field_create(int width, int height, int cost_max);
+void path_field_destroy(struct PathField *pf);
+
+/** @brief Makes the field hold the costs of reaching all the fields from
+  *        the root, going around the asteroids. The flood is only redone when
+  *        the root differs from the one of the previous update.
+  * @param pf The field to update.
+  * @param d The data in which the distances are measured.
+  * @param root The index of the field to measure the distances from.
+  */
+void path_field_update(struct PathField *pf, const struct Data *d, int root);
+
+/** @brief Returns the cost of reaching a field from the root, which is
+  *        its distance on maps without terrain, -1 if unreachable.
+  */
+int path_field_distance(const struct PathField *pf, int cell);
+
+/** @brief Returns the neighbour one step closer to the root on a cheapest
+  *        path.
+  * @return The index of the next field, -1 if the cell is the root
+  *         or the root cannot be reached from it.
+  */
+int path_field_next(const struct PathField *pf, int cell);
+
+#endif
@@ -0,0 +1,145 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "data.h"
+#include "pool.h"
+
+#define POOL_CHUNK_CELLS (64 * 1024)
+#define POOL_MIN_CLASS_SHIFT 4
+#define POOL_CLASSES 28
+
+/* Every array is preceded by a header holding its size class. The header
+ * is two ints wide so the array stays aligned for the free list link. */
+#define POOL_HEADER 2
+
+struct PoolChunk {
+    struct PoolChunk *next;
+    size_t capacity;
+    int cells[];
+};
+
+struct Pool {
+    enum pool_mode mode;
+    struct PoolChunk *first, *last;
+    struct PoolChunk *current;
+    size_t used;
+    size_t reserved;
+    int *free_lists[POOL_CLASSES];
+};
+
+struct Pool *pool_create(enum pool_mode mode)
+{
+    struct Pool *p = data_alloc(sizeof(*p));
+    memset(p, 0, sizeof(*p));
+    p->mode = mode;
+    return p;
+}
+
+void pool_destroy(struct Pool *p)
+{
+    struct PoolChunk *chunk, *next;
+
+    if (p == NULL) {
+        return;
+    }
+    for (chunk = p->first; chunk != NULL; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+    free(p);
+}
+
+enum pool_mode pool_get_mode(const struct Pool *p)
+{
+    return p->mode;
+}
+
+static int pool_CLASS(int length)
+{
+    int class = 0;
+    while (((size_t)1 << (class + POOL_MIN_CLASS_SHIFT)) < (size_t)length) {
+        ++class;
+    }
+    return class;
+}
+
+/* Takes cells from the chunks, moving on to the next chunk (or a new one)
+ * when the current one is too full. */
+static int *pool_BUMP(struct Pool *p, size_t cells)
+{
+    struct PoolChunk *chunk;
+    size_t capacity;
+    int *result;
+
+    while (p->current != NULL && p->current->capacity - p->used < cells) {
+        p->current = p->current->next;
+        p->used = 0;
+    }
+
+    if (p->current == NULL) {
+        capacity = cells > POOL_CHUNK_CELLS ? cells : POOL_CHUNK_CELLS;
+        chunk = data_alloc(sizeof(*chunk) + capacity * sizeof(int));
+        chunk->next = NULL;
+        chunk->capacity = capacity;
+        if (p->last != NULL) {
+            p->last->next = chunk;
+        } else {
+            p->first = chunk;
+        }
+        p->last = chunk;
+        p->current = chunk;
+        p->used = 0;
+        p->reserved += capacity * sizeof(int);
+    }
+
+    result = p->current->cells + p->used;
+    p->used += cells;
+    return result;
+}
+
+int *pool_alloc(struct Pool *p, int length)
+{
+    const int class = pool_CLASS(length);
+    int *array;
+
+    if ((array = p->free_lists[class]) != NULL) {
+        memcpy(&p->free_lists[class], array, sizeof(array));
+        return array;
+    }
+
+    array = pool_BUMP(p, POOL_HEADER +
+            ((size_t)1 << (class + POOL_MIN_CLASS_SHIFT))) + POOL_HEADER;
+    array[-POOL_HEADER] = class;
+    return array;
+}
+
+int pool_capacity(const int *array)
+{
+    return 1 << (array[-POOL_HEADER] + POOL_MIN_CLASS_SHIFT);
+}
+
+void pool_free(struct Pool *p, int *array)
+{
+    int class;
+
+    if (array == NULL || p->mode == POOL_TURN) {
+        return;
+    }
+
+    class = array[-POOL_HEADER];
+    memcpy(array, &p->free_lists[class], sizeof(array));
+    p->free_lists[class] = array;
+}
+
+void pool_reset(struct Pool *p)
+{
+    memset(p->free_lists, 0, sizeof(p->free_lists));
+    p->current = p->first;
+    p->used = 0;
+}
+
+size_t pool_reserved(const struct Pool *p)
+{
+    return p->reserved;
+}
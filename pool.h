@@ -0,0 +1,44 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+enum pool_mode {
+    POOL_KEEP,
+    POOL_TURN
+};
+
+/*
+ * Pool of int arrays carved from big chunks. In the POOL_KEEP mode freed
+ * arrays go to a free list per power-of-two size class and are reused by
+ * later allocations. In the POOL_TURN mode freeing is a no-op and the whole
+ * pool is recycled at once by pool_reset. Chunks are only returned to the
+ * system by pool_destroy.
+ */
+struct Pool;
+
+struct Pool *pool_create(enum pool_mode mode);
+void pool_destroy(struct Pool *p);
+
+enum pool_mode pool_get_mode(const struct Pool *p);
+
+/** @brief Allocates an array of length ints, terminating on failure. */
+int *pool_alloc(struct Pool *p, int length);
+
+/** @brief Returns how many ints an array can hold, which is at least
+  *        the length it was allocated with.
+  */
+int pool_capacity(const int *array);
+
+/** @brief Returns an array to the pool. NULL is ignored. */
+void pool_free(struct Pool *p, int *array);
+
+/** @brief Invalidates all the arrays allocated so far and makes their
+  *        memory available again without returning it to the system.
+  */
+void pool_reset(struct Pool *p);
+
+/** @brief Returns the number of bytes held in chunks. */
+size_t pool_reserved(const struct Pool *p);
+
+#endif
@@ -0,0 +1,58 @@
+#include "rng.h"
+
+static uint64_t rng_ROTL(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/* SplitMix64, used to spread the seed over the whole state. */
+static uint64_t rng_SPLITMIX(uint64_t *x)
+{
+    uint64_t z = (*x += UINT64_C(0x9e3779b97f4a7c15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return z ^ (z >> 31);
+}
+
+void rng_seed(struct Rng *r, uint64_t seed)
+{
+    int i;
+    for (i = 0; i < 4; ++i) {
+        r->s[i] = rng_SPLITMIX(&seed);
+    }
+}
+
+uint64_t rng_next(struct Rng *r)
+{
+    const uint64_t result = rng_ROTL(r->s[1] * 5, 7) * 9;
+    const uint64_t t = r->s[1] << 17;
+
+    r->s[2] ^= r->s[0];
+    r->s[3] ^= r->s[1];
+    r->s[1] ^= r->s[2];
+    r->s[0] ^= r->s[3];
+    r->s[2] ^= t;
+    r->s[3] = rng_ROTL(r->s[3], 45);
+
+    return result;
+}
+
+int rng_range(struct Rng *r, int min, int max)
+{
+    uint32_t range, threshold;
+    uint64_t product;
+
+    if (max <= min) {
+        return min;
+    }
+
+    /* Lemire's multiply-shift reduction with rejection of the biased low
+     * products; the loop rarely runs more than once. */
+    range = (uint32_t)((int64_t)max - min);
+    threshold = -range % range;
+    do {
+        product = (uint64_t)(uint32_t)(rng_next(r) >> 32) * range;
+    } while ((uint32_t)product < threshold);
+
+    return min + (int)(product >> 32);
+}
@@ -0,0 +1,22 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/** @brief State of a xoshiro256** generator. */
+struct Rng {
+    uint64_t s[4];
+};
+
+/** @brief Seeds a generator deterministically from a single value. */
+void rng_seed(struct Rng *r, uint64_t seed);
+
+/** @brief Returns the next 64 random bits. */
+uint64_t rng_next(struct Rng *r);
+
+/** @brief Returns an unbiased random integer in the range [min, max).
+  * @return The random value, min if the range is empty.
+  */
+int rng_range(struct Rng *r, int min, int max);
+
+#endif
@@ -1,106 +1,119 @@
-#include <stdlib.h>
 #include "scan.h"
+#include "stats.h"
 
 int scan_generic(
 		int x1, int y1, int x2, int y2,
 		struct Data* d, int(*func)(struct Data*, int, int))
 {
-    int dx, dy;
-    int i, max_i;
-    double x, y, fdx, fdy;
-    int scan_result;
+    struct ScanLine line;
+    int scan_result = 0;
+    int cells = 0;
+
+    scan_line_init(&line, x1, y1, x2, y2);
+    while (scan_line_next(&line)) {
+        ++cells;
+        if ((scan_result = func(d, line.x, line.y)) != 0) {
+            break;
+        }
+    }
 
-    dx = x2 - x1;
-    dy = y2 - y1;
+    STATS_ADD(SC_SCAN_CALLS, 1);
+    STATS_ADD(SC_SCAN_CELLS, cells);
+    return scan_result;
+}
 
-    if (dx == 0 && dy == 0) {
-        return func(d, x1, y1);
-    }
+static inline int scan_plot_FIELD(struct Data *d, int x, int y)
+{
+    const int cell = y * d->width + x;
+    data_plane_set(d->visible, cell);
+    return data_plane_get(d->blocked, cell) | data_plane_get(d->occupied, cell);
+}
 
-    x = (double)x1 + 0.5;
-    y = (double)y1 + 0.5;
-
-    if (abs(dx) > abs(dy)) {
-        if (x2 > x1) {
-            fdx = 1.0;
-            fdy = (double)dy / (double)dx;
-            max_i = dx;
-        } else {
-            fdx = -1.0;
-            fdy = -((double)dy / (double)dx);
-            max_i = -dx;
-        }
-    } else {
-        if (y2 > y1) {
-            fdx = (double)dx / (double)dy;
-            fdy = 1.0;
-            max_i = dy;
-        } else {
-            fdx = -((double)dx / (double)dy);
-            fdy = -1.0;
-            max_i = -dy;
-        }
+static inline int scan_visibility_FIELD(struct Data *d, int x, int y)
+{
+    const int cell = y * d->width + x;
+
+    if (data_plane_get(d->blocked, cell)) {
+        return FAKE_ASTEROID_INDEX;
     }
 
-    // Skip source field.
-    x += fdx;
-    y += fdy;
+    if (data_plane_get(d->occupied, cell)) {
+        return d->enemy_map[cell] + 1; // Solve case when enemy 0 hit
+    }
 
-    for (i = 1; i <= max_i; ++i) {
-        if ((scan_result = func(d, x, y)) != 0) {
-            return scan_result;
-        }
-        x += fdx;
-        y += fdy;
+    if (x == d->player.x && y == d->player.y) {
+        return FAKE_PLAYER_INDEX;
     }
 
     return 0;
 }
 
+
 int scan_plot(struct Data *d, int x, int y)
 {
-    int i;
+    STATS_ADD(SC_SCAN_CALLBACKS, 1);
+    return scan_plot_FIELD(d, x, y);
+}
 
-    for (i = 0; i < d->asteroids_count; ++i) {
-        if (x >= d->asteroids[i].x1 && x <= d->asteroids[i].x2 &&
-            y >= d->asteroids[i].y1 && y <= d->asteroids[i].y2) {
-            d->map_buffer[y * MAP_WIDTH + x] = SF_ASTEROID;
-            return 1;
-        }
-    }
+int scan_visibility(struct Data *d, int x, int y)
+{
+    STATS_ADD(SC_SCAN_CALLBACKS, 1);
+    return scan_visibility_FIELD(d, x, y);
+}
 
-    for (i = 0; i < d->enemies_count; ++i) {
-        if (x == d->enemies[i].x && y == d->enemies[i].y) {
-            d->map_buffer[y * MAP_WIDTH + x] = '0' + i;
-            return 1;
-        }
+/* Defines a scan_generic equivalent with a fixed, inlineable callback. */
+#define SCAN_DEFINE(MACRO_name, MACRO_func)\
+    static inline int MACRO_name(\
+            int x1, int y1, int x2, int y2, struct Data *d)\
+    {\
+        struct ScanLine MACRO_line;\
+        int MACRO_result = 0;\
+        int MACRO_cells = 0;\
+        scan_line_init(&MACRO_line, x1, y1, x2, y2);\
+        while (scan_line_next(&MACRO_line)) {\
+            ++MACRO_cells;\
+            if ((MACRO_result = MACRO_func(d, MACRO_line.x, MACRO_line.y)) != 0) {\
+                break;\
+            }\
+        }\
+        STATS_ADD(SC_SCAN_CALLS, 1);\
+        STATS_ADD(SC_SCAN_CELLS, MACRO_cells);\
+        return MACRO_result;\
     }
 
-    d->map_buffer[y * MAP_WIDTH + x] = SF_SPACE;
-    return 0;
-}
+SCAN_DEFINE(scan_line_plot_WALK, scan_plot_FIELD)
+SCAN_DEFINE(scan_line_visibility_WALK, scan_visibility_FIELD)
 
-int scan_visibility(struct Data *d, int x, int y)
+int scan_line_plot(int x1, int y1, int x2, int y2, struct Data *d)
 {
-    int i;
+    return scan_line_plot_WALK(x1, y1, x2, y2, d);
+}
 
-    for (i = 0; i < d->asteroids_count; ++i) {
-        if (x >= d->asteroids[i].x1 && x <= d->asteroids[i].x2 &&
-            y >= d->asteroids[i].y1 && y <= d->asteroids[i].y2) {
-            return FAKE_ASTEROID_INDEX;
-        }
-    }
+int scan_line_visibility(int x1, int y1, int x2, int y2, struct Data *d)
+{
+    return scan_line_visibility_WALK(x1, y1, x2, y2, d);
+}
 
-    for (i = 0; i < d->enemies_count; ++i) {
-        if (x == d->enemies[i].x && y == d->enemies[i].y) {
-            return i + 1; // Solve case when enemy 0 hit
-        }
+void scan_visibility_batch(
+        struct Data *d,
+        const int *x1, const int *y1, int count,
+        int x2, int y2,
+        int *results)
+{
+    int i;
+    for (i = 0; i < count; ++i) {
+        results[i] = scan_line_visibility_WALK(x1[i], y1[i], x2, y2, d);
     }
+}
 
-    if (x == d->player.x && y == d->player.y) {
-        return FAKE_PLAYER_INDEX;
+void scan_visibility_fan(
+        struct Data *d,
+        int x1, int y1,
+        const int *x2, const int *y2, int count,
+        int *results)
+{
+    int i;
+    for (i = 0; i < count; ++i) {
+        results[i] = scan_line_visibility_WALK(x1, y1, x2[i], y2[i], d);
     }
-
-    return 0;
 }
-
@@ -3,6 +3,82 @@
 
 #include "data.h"
 
+/** @brief State of an integer walk along a scan line. The walk starts at
+  *        the center of the source field, advances one field along the
+  *        major axis per step and moves along the minor axis whenever the
+  *        exact line crosses into the next field. The source field itself
+  *        is skipped unless the line has zero length.
+  */
+struct ScanLine {
+    int x, y;
+    int major_x, major_y;
+    int minor_x, minor_y;
+    int error, error_step, error_range;
+    int remaining;
+};
+
+static inline void scan_line_init(
+        struct ScanLine *l,
+        int x1, int y1, int x2, int y2)
+{
+    const int dx = x2 - x1;
+    const int dy = y2 - y1;
+    const int adx = dx < 0 ? -dx : dx;
+    const int ady = dy < 0 ? -dy : dy;
+    const int sx = dx < 0 ? -1 : 1;
+    const int sy = dy < 0 ? -1 : 1;
+
+    l->x = x1;
+    l->y = y1;
+
+    if (dx == 0 && dy == 0) {
+        l->major_x = l->major_y = 0;
+        l->minor_x = l->minor_y = 0;
+        l->error = 0;
+        l->error_step = 0;
+        l->error_range = 1;
+        l->remaining = 1;
+    } else if (adx > ady) {
+        l->major_x = sx;
+        l->major_y = 0;
+        l->minor_x = 0;
+        l->minor_y = sy;
+        l->error = dy < 0 ? adx - 1 : adx;
+        l->error_step = 2 * ady;
+        l->error_range = 2 * adx;
+        l->remaining = adx;
+    } else {
+        l->major_x = 0;
+        l->major_y = sy;
+        l->minor_x = sx;
+        l->minor_y = 0;
+        l->error = dx < 0 ? ady - 1 : ady;
+        l->error_step = 2 * adx;
+        l->error_range = 2 * ady;
+        l->remaining = ady;
+    }
+}
+
+/** @brief Advances the walk to the next field of the scan line.
+  * @return True if l->x, l->y hold the next field, false at the end.
+  */
+static inline bool scan_line_next(struct ScanLine *l)
+{
+    if (l->remaining == 0) {
+        return false;
+    }
+    --l->remaining;
+    l->x += l->major_x;
+    l->y += l->major_y;
+    l->error += l->error_step;
+    if (l->error >= l->error_range) {
+        l->error -= l->error_range;
+        l->x += l->minor_x;
+        l->y += l->minor_y;
+    }
+    return true;
+}
+
 /** @brief Scans a line between two points, calling a callback function
   *        for each point along the scan line. If the callback returns
   *        a non-zero value, the scan is stopped and the value is returned.
@@ -19,11 +95,13 @@ int scan_generic(
 		int x1, int y1, int x2, int y2,
 		struct Data* d, int(*func)(struct Data*, int, int));
 
-/** @brief Callback function for a map plotting scan.
+/** @brief Callback function for a map plotting scan, marking the field
+  *        in the visible plane.
   * @param d The data in which the scan is performed.
   * @param x The x coordinate of the scanned point.
   * @param y The y coordinate of the scanned point.
-  * @return 0 in nothing was detected, 1 if an obstacle was hit.
+  * @return 0 in nothing was detected, 1 if an asteroid or an enemy
+  *         was hit.
   */
 int scan_plot(struct Data *d, int x, int y);
 
@@ -38,4 +116,41 @@ int scan_plot(struct Data *d, int x, int y);
   */
 int scan_visibility(struct Data *d, int x, int y);
 
+/** @brief Equivalents of scan_generic with the scan_plot and
+  *        scan_visibility callbacks compiled into the walk.
+  */
+int scan_line_plot(int x1, int y1, int x2, int y2, struct Data *d);
+int scan_line_visibility(int x1, int y1, int x2, int y2, struct Data *d);
+
+/** @brief Performs visibility scans from many points to a common target.
+  * @param d The data in which the scans are performed.
+  * @param x1 The x coordinates of the start points.
+  * @param y1 The y coordinates of the start points.
+  * @param count The number of start points.
+  * @param x2 The x coordinate of the target.
+  * @param y2 The y coordinate of the target.
+  * @param[out] results The scan_visibility hit value for each scan.
+  */
+void scan_visibility_batch(
+        struct Data *d,
+        const int *x1, const int *y1, int count,
+        int x2, int y2,
+        int *results);
+
+/** @brief Performs visibility scans from a common point to many targets,
+  *        telling for each target what a shot at it would hit first.
+  * @param d The data in which the scans are performed.
+  * @param x1 The x coordinate of the start point.
+  * @param y1 The y coordinate of the start point.
+  * @param x2 The x coordinates of the targets.
+  * @param y2 The y coordinates of the targets.
+  * @param count The number of targets.
+  * @param[out] results The scan_visibility hit value for each scan.
+  */
+void scan_visibility_fan(
+        struct Data *d,
+        int x1, int y1,
+        const int *x2, const int *y2, int count,
+        int *results);
+
 #endif
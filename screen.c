@@ -0,0 +1,186 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "data.h"
+#include "screen.h"
+
+/* Unchanged characters cheaper to resend than to skip with a cursor move. */
+#define SCREEN_GAP 6
+
+struct Screen {
+    int cols, rows;
+    char *frame;
+    char *previous;
+    bool full;
+
+    char *out;
+    size_t out_length;
+    size_t out_capacity;
+};
+
+struct Screen *screen_create(void)
+{
+    struct Screen *s = data_alloc(sizeof(*s));
+    memset(s, 0, sizeof(*s));
+    s->full = true;
+    return s;
+}
+
+void screen_destroy(struct Screen *s)
+{
+    if (s == NULL) {
+        return;
+    }
+    free(s->frame);
+    free(s->previous);
+    free(s->out);
+    free(s);
+}
+
+void screen_begin(struct Screen *s, int cols, int rows)
+{
+    const size_t size = (size_t)cols * rows;
+
+    if (cols != s->cols || rows != s->rows) {
+        free(s->frame);
+        free(s->previous);
+        s->cols = cols;
+        s->rows = rows;
+        s->frame = data_alloc(size);
+        s->previous = data_alloc(size);
+        s->full = true;
+    }
+    memset(s->frame, ' ', size);
+}
+
+void screen_put(struct Screen *s, int row, int col,
+        const char *text, int length)
+{
+    if (row < 0 || row >= s->rows || col < 0 || col >= s->cols) {
+        return;
+    }
+    if (length > s->cols - col) {
+        length = s->cols - col;
+    }
+    memcpy(s->frame + (size_t)row * s->cols + col, text, length);
+}
+
+void screen_fill(struct Screen *s, int row, int col, char c, int count)
+{
+    if (row < 0 || row >= s->rows || col < 0 || col >= s->cols) {
+        return;
+    }
+    if (count > s->cols - col) {
+        count = s->cols - col;
+    }
+    memset(s->frame + (size_t)row * s->cols + col, c, count);
+}
+
+void screen_invalidate(struct Screen *s)
+{
+    s->full = true;
+}
+
+static void screen_RESERVE(struct Screen *s, size_t length)
+{
+    if (s->out_length + length <= s->out_capacity) {
+        return;
+    }
+    while (s->out_length + length > s->out_capacity) {
+        s->out_capacity = s->out_capacity ? 2 * s->out_capacity : 4096;
+    }
+    s->out = realloc(s->out, s->out_capacity);
+    if (!s->out) {
+        fprintf(stderr, "ERROR: Failed growing the screen buffer.\n");
+        exit(1);
+    }
+}
+
+static void screen_APPEND(struct Screen *s, const char *text, size_t length)
+{
+    screen_RESERVE(s, length);
+    memcpy(s->out + s->out_length, text, length);
+    s->out_length += length;
+}
+
+static void screen_MOVE(struct Screen *s, int row, int col)
+{
+    char move[32];
+    const int length = snprintf(move, sizeof(move),
+            "\033[%d;%dH", row + 1, col + 1);
+    screen_APPEND(s, move, length);
+}
+
+/* Appends the changed spans of a row, merging the spans separated by
+ * less than SCREEN_GAP unchanged characters. */
+static void screen_DIFF_ROW(struct Screen *s, int row)
+{
+    const char *cur = s->frame + (size_t)row * s->cols;
+    const char *old = s->previous + (size_t)row * s->cols;
+    int begin, end, next;
+
+    for (begin = 0; begin < s->cols; begin = end) {
+        if (cur[begin] == old[begin]) {
+            end = begin + 1;
+            continue;
+        }
+        end = begin + 1;
+        for (next = end; next < s->cols && next - end < SCREEN_GAP; ++next) {
+            if (cur[next] != old[next]) {
+                end = next + 1;
+            }
+        }
+        screen_MOVE(s, row, begin);
+        screen_APPEND(s, cur + begin, end - begin);
+    }
+}
+
+static void screen_WRITE(struct Screen *s, int fd)
+{
+    size_t done = 0;
+    ssize_t result;
+
+    while (done < s->out_length) {
+        result = write(fd, s->out + done, s->out_length - done);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        done += result;
+    }
+}
+
+size_t screen_flush(struct Screen *s, int fd)
+{
+    static const char clear[] = "\033[H\033[2J";
+    int row;
+    size_t written;
+
+    s->out_length = 0;
+
+    if (s->full) {
+        screen_APPEND(s, clear, sizeof(clear) - 1);
+        for (row = 0; row < s->rows; ++row) {
+            screen_APPEND(s, s->frame + (size_t)row * s->cols, s->cols);
+            screen_APPEND(s, "\r\n", 2);
+        }
+        s->full = false;
+    } else {
+        for (row = 0; row < s->rows; ++row) {
+            screen_DIFF_ROW(s, row);
+        }
+        screen_MOVE(s, s->rows, 0);
+    }
+
+    screen_WRITE(s, fd);
+    written = s->out_length;
+
+    memcpy(s->previous, s->frame, (size_t)s->cols * s->rows);
+    return written;
+}
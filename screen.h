@@ -0,0 +1,45 @@
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <stddef.h>
+
+/*
+ * Terminal frame renderer. A frame is a grid of characters drawn with
+ * screen_put between screen_begin and screen_flush. Flushing compares the
+ * frame with the previously flushed one and sends only the cursor moves
+ * and the changed characters, all in a single write.
+ */
+struct Screen;
+
+struct Screen *screen_create(void);
+void screen_destroy(struct Screen *s);
+
+/** @brief Starts a new blank frame. A frame of a different size than the
+  *        previous one is redrawn completely.
+  */
+void screen_begin(struct Screen *s, int cols, int rows);
+
+/** @brief Draws text into the current frame, clipped to the frame.
+  * @param row The row of the first character, from 0.
+  * @param col The column of the first character, from 0.
+  * @param text The characters to draw.
+  * @param length The number of characters to draw.
+  */
+void screen_put(struct Screen *s, int row, int col,
+        const char *text, int length);
+
+/** @brief Draws a run of count copies of a character. */
+void screen_fill(struct Screen *s, int row, int col, char c, int count);
+
+/** @brief Makes the next flush redraw the whole frame, e.g. after other
+  *        output has been written to the terminal.
+  */
+void screen_invalidate(struct Screen *s);
+
+/** @brief Sends the differences from the previous frame to a terminal
+  *        and leaves the cursor on the line below the frame.
+  * @return The number of bytes written.
+  */
+size_t screen_flush(struct Screen *s, int fd);
+
+#endif
@@ -0,0 +1,638 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "server.h"
+
+#define SERVER_BACKLOG 128
+#define SERVER_EVENTS 64
+#define SERVER_LINE_MAX 64
+#define SERVER_OUT_INITIAL 256
+/* Sessions that do not read their replies stop being read from once
+ * this much output is waiting. */
+#define SERVER_OUT_MAX 65536
+
+/*
+ * Sessions.
+ * =========
+ */
+
+struct ServerSession {
+    int fd;
+    struct ServerShard *shard;
+    struct ServerSession *prev, *next;
+
+    struct Game game;
+    bool playing;
+    long turns;
+
+    char in[SERVER_LINE_MAX];
+    size_t in_length;
+
+    char *out;
+    size_t out_length, out_sent, out_capacity;
+    /* The events the session is registered for. */
+    uint32_t events;
+    bool closing;
+};
+
+struct ServerShard {
+    struct Server *server;
+    int epoll;
+    pthread_t thread;
+    struct ServerSession *sessions;
+};
+
+struct Server {
+    const struct ServerConfig *config;
+    int listen_fd;
+    int stop_fd;
+    unsigned long sessions_started;
+};
+
+static int server_stop_fd = -1;
+
+static void server_SIGNAL(int signal)
+{
+    const uint64_t one = 1;
+    const int saved_errno = errno;
+
+    (void)signal;
+    if (write(server_stop_fd, &one, sizeof(one)) < 0) {
+        /* Nothing more can be done in a signal handler. */
+    }
+    errno = saved_errno;
+}
+
+static void server_PRINTF(struct ServerSession *s, const char *format, ...)
+{
+    va_list args;
+    int length;
+
+    for (;;) {
+        va_start(args, format);
+        length = vsnprintf(s->out + s->out_length,
+                s->out_capacity - s->out_length, format, args);
+        va_end(args);
+        if (length < 0) {
+            return;
+        }
+        if ((size_t)length < s->out_capacity - s->out_length) {
+            s->out_length += length;
+            return;
+        }
+        s->out_capacity *= 2;
+        if ((s->out = realloc(s->out, s->out_capacity)) == NULL) {
+            fprintf(stderr, "ERROR: Failed growing a session buffer.\n");
+            exit(1);
+        }
+    }
+}
+
+/* Sends a game message as one line, without its own line break. */
+static void server_GAME_MESSAGE(void *context, const char *message)
+{
+    const size_t length = strcspn(message, "\n");
+    server_PRINTF(context, "msg %.*s\n", (int)length, message);
+}
+
+static void server_HELLO(struct ServerSession *s)
+{
+    server_PRINTF(s, "hello %d %d %d\n", s->game.data.width,
+            s->game.data.height, s->game.data.enemies_count);
+}
+
+static void server_session_NEW_MATCH(struct ServerSession *s, bool first)
+{
+    if (!first) {
+        game_deinit(&s->game);
+    }
+    game_init(&s->game, &s->shard->server->config->data);
+    game_plot(&s->game);
+    s->playing = true;
+    s->turns = 0;
+    server_HELLO(s);
+}
+
+static struct ServerSession *server_session_CREATE(
+        struct ServerShard *shard, int fd)
+{
+    struct Server *server = shard->server;
+    struct ServerSession *s = calloc(1, sizeof(*s));
+    struct GameConfig config = server->config->game;
+    const unsigned long number =
+        __atomic_fetch_add(&server->sessions_started, 1, __ATOMIC_RELAXED);
+
+    if (s == NULL || (s->out = malloc(SERVER_OUT_INITIAL)) == NULL) {
+        fprintf(stderr, "ERROR: Failed allocating a session.\n");
+        exit(1);
+    }
+    s->fd = fd;
+    s->shard = shard;
+    s->out_capacity = SERVER_OUT_INITIAL;
+
+    config.workers = NULL;
+    config.message = server_GAME_MESSAGE;
+    config.message_context = s;
+    game_create(&s->game, &config, server->config->seed ^
+            ((uint64_t)number * UINT64_C(0x9e3779b97f4a7c15)));
+    server_session_NEW_MATCH(s, true);
+
+    s->next = shard->sessions;
+    if (shard->sessions != NULL) {
+        shard->sessions->prev = s;
+    }
+    shard->sessions = s;
+    return s;
+}
+
+static void server_session_DESTROY(struct ServerSession *s)
+{
+    struct ServerShard *shard = s->shard;
+
+    if (s->prev != NULL) {
+        s->prev->next = s->next;
+    } else {
+        shard->sessions = s->next;
+    }
+    if (s->next != NULL) {
+        s->next->prev = s->prev;
+    }
+
+    epoll_ctl(shard->epoll, EPOLL_CTL_DEL, s->fd, NULL);
+    close(s->fd);
+    game_deinit(&s->game);
+    free(s->out);
+    free(s);
+}
+
+/*
+ * Commands.
+ * =========
+ */
+
+static void server_TURN(struct ServerSession *s, int c, int target)
+{
+    static const char *const results[] = { "play", "won", "lost" };
+    enum game_result result;
+
+    if (!s->playing) {
+        server_PRINTF(s, "error match over\n");
+        return;
+    }
+
+    result = game_step(&s->game, c, target);
+    ++s->turns;
+    s->playing = result == GR_CONTINUE;
+    server_PRINTF(s, "state %ld %d %d %d %s\n", s->turns,
+            s->game.data.player.x, s->game.data.player.y,
+            s->game.data.enemies_count, results[result]);
+}
+
+static void server_TARGETS(struct ServerSession *s)
+{
+    int i;
+
+    server_PRINTF(s, "targets");
+    if (s->playing && game_find_targets(&s->game) > 0) {
+        for (i = 0; i < s->game.data.enemies_count; ++i) {
+            if (s->game.turn.hit[i] == i + 1) {
+                server_PRINTF(s, " %d", s->game.data.enemies.id[i]);
+            }
+        }
+    }
+    server_PRINTF(s, "\n");
+}
+
+static void server_COMMAND(struct ServerSession *s, const char *line)
+{
+    char *end;
+    long target;
+
+    /* Only L takes an argument, any other command must stand alone. */
+    if (line[0] == '\0' || (line[1] != '\0' &&
+            (line[0] != 'L' || line[1] != ' '))) {
+        server_PRINTF(s, "error unknown command\n");
+        return;
+    }
+
+    switch (line[0]) {
+    case 'h':
+    case 'j':
+    case 'k':
+    case 'l':
+    case 'A':
+        server_TURN(s, line[0], -1);
+        break;
+    case 'L':
+        target = strtol(line + 1, &end, 10);
+        if (end == line + 1 || *end != '\0' || target < 0 || target > INT_MAX) {
+            server_PRINTF(s, "error invalid target\n");
+        } else {
+            server_TURN(s, 'L', target);
+        }
+        break;
+    case 't':
+        server_TARGETS(s);
+        break;
+    case 'n':
+        server_session_NEW_MATCH(s, false);
+        break;
+    case 'q':
+        server_PRINTF(s, "bye\n");
+        s->closing = true;
+        break;
+    default:
+        server_PRINTF(s, "error unknown command\n");
+        break;
+    }
+}
+
+/*
+ * Event loop.
+ * ===========
+ */
+
+static void server_session_WATCH(struct ServerSession *s, uint32_t events)
+{
+    struct epoll_event event;
+
+    if (events == s->events) {
+        return;
+    }
+    event.events = events;
+    event.data.ptr = s;
+    epoll_ctl(s->shard->epoll, EPOLL_CTL_MOD, s->fd, &event);
+    s->events = events;
+}
+
+/* Sends what the socket takes, then waits for it to take more or for
+ * the next commands.
+ * @return False if the session is over. */
+static bool server_session_FLUSH(struct ServerSession *s)
+{
+    ssize_t sent;
+    uint32_t events = 0;
+
+    while (s->out_sent < s->out_length) {
+        sent = send(s->fd, s->out + s->out_sent, s->out_length - s->out_sent,
+                MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return false;
+        }
+        s->out_sent += sent;
+    }
+    if (s->out_sent == s->out_length) {
+        s->out_sent = s->out_length = 0;
+        if (s->closing) {
+            return false;
+        }
+    } else {
+        events |= EPOLLOUT;
+    }
+
+    if (!s->closing && s->out_length - s->out_sent < SERVER_OUT_MAX) {
+        events |= EPOLLIN;
+    }
+    server_session_WATCH(s, events);
+    return true;
+}
+
+/* Plays the complete lines received so far.
+ * @return False if the session is over. */
+static bool server_session_READ(struct ServerSession *s)
+{
+    ssize_t received;
+    char *newline;
+    size_t used;
+
+    for (;;) {
+        received = recv(s->fd, s->in + s->in_length,
+                sizeof(s->in) - s->in_length, 0);
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        } else if (received == 0) {
+            /* The client is done sending, the replies still go out. */
+            s->closing = true;
+            return true;
+        }
+        s->in_length += received;
+
+        while (!s->closing &&
+               (newline = memchr(s->in, '\n', s->in_length)) != NULL) {
+            *newline = '\0';
+            if (newline > s->in && newline[-1] == '\r') {
+                newline[-1] = '\0';
+            }
+            server_COMMAND(s, s->in);
+            used = newline + 1 - s->in;
+            memmove(s->in, newline + 1, s->in_length - used);
+            s->in_length -= used;
+        }
+        if (s->in_length == sizeof(s->in)) {
+            server_PRINTF(s, "error line too long\n");
+            s->closing = true;
+        }
+        if (s->closing || s->out_length - s->out_sent >= SERVER_OUT_MAX) {
+            return true;
+        }
+    }
+}
+
+static void server_ACCEPT(struct ServerShard *shard)
+{
+    struct ServerSession *s;
+    struct epoll_event event;
+    int fd;
+
+    while ((fd = accept4(shard->server->listen_fd, NULL, NULL,
+                    SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        s = server_session_CREATE(shard, fd);
+        event.events = s->events = EPOLLIN;
+        event.data.ptr = s;
+        if (epoll_ctl(shard->epoll, EPOLL_CTL_ADD, fd, &event) < 0 ||
+            !server_session_FLUSH(s)) {
+                server_session_DESTROY(s);
+        }
+    }
+}
+
+static void *server_SHARD(void *arg)
+{
+    struct ServerShard *shard = arg;
+    struct Server *server = shard->server;
+    struct epoll_event events[SERVER_EVENTS];
+    struct ServerSession *s;
+    int i, count;
+    bool alive;
+
+    for (;;) {
+        count = epoll_wait(shard->epoll, events, SERVER_EVENTS, -1);
+        if (count < 0 && errno != EINTR) {
+            fprintf(stderr, "ERROR: Failed waiting for sessions.\n");
+            break;
+        }
+        for (i = 0; i < count; ++i) {
+            if (events[i].data.ptr == &server->stop_fd) {
+                return NULL;
+            } else if (events[i].data.ptr == &server->listen_fd) {
+                server_ACCEPT(shard);
+                continue;
+            }
+
+            s = events[i].data.ptr;
+            alive = !(events[i].events & (EPOLLERR | EPOLLHUP)) ||
+                    (events[i].events & EPOLLIN);
+            if (alive && (events[i].events & EPOLLIN)) {
+                alive = server_session_READ(s);
+            }
+            if (alive) {
+                alive = server_session_FLUSH(s);
+            }
+            if (!alive) {
+                server_session_DESTROY(s);
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Server.
+ * =======
+ */
+
+static int server_LISTEN(const char *path)
+{
+    struct sockaddr_un address;
+    int fd;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "ERROR: Socket path %s is too long.\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Failed creating a socket.\n");
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+        listen(fd, SERVER_BACKLOG) < 0) {
+            fprintf(stderr, "ERROR: Failed listening on %s.\n", path);
+            close(fd);
+            return -1;
+    }
+    return fd;
+}
+
+/* Every shard waits for the listening socket, EPOLLEXCLUSIVE waking only
+ * one of them per connection, and for the stop event, which stays
+ * signalled and so wakes them all. */
+static bool server_shard_INIT(struct ServerShard *shard, struct Server *server)
+{
+    struct epoll_event event;
+
+    shard->server = server;
+    shard->sessions = NULL;
+    if ((shard->epoll = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        return false;
+    }
+
+    event.events = EPOLLIN | EPOLLEXCLUSIVE;
+    event.data.ptr = &server->listen_fd;
+    if (epoll_ctl(shard->epoll, EPOLL_CTL_ADD, server->listen_fd, &event) < 0) {
+        return false;
+    }
+    event.events = EPOLLIN;
+    event.data.ptr = &server->stop_fd;
+    return epoll_ctl(shard->epoll, EPOLL_CTL_ADD, server->stop_fd, &event) == 0;
+}
+
+bool server_run(const struct ServerConfig *config)
+{
+    struct Server server;
+    struct ServerShard *shards;
+    struct sigaction action, old_int, old_term;
+    int i, started = 1;
+    bool ok = true;
+
+    server.config = config;
+    server.sessions_started = 0;
+    if ((server.listen_fd = server_LISTEN(config->path)) < 0) {
+        return false;
+    }
+    if ((server.stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        fprintf(stderr, "ERROR: Failed creating the stop event.\n");
+        close(server.listen_fd);
+        unlink(config->path);
+        return false;
+    }
+
+    server_stop_fd = server.stop_fd;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = server_SIGNAL;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, &old_int);
+    sigaction(SIGTERM, &action, &old_term);
+
+    shards = calloc(config->shards, sizeof(*shards));
+    for (i = 0; shards != NULL && i < config->shards && ok; ++i) {
+        ok = server_shard_INIT(&shards[i], &server);
+    }
+    if (shards == NULL || !ok) {
+        fprintf(stderr, "ERROR: Failed setting up the event loops.\n");
+        ok = false;
+    }
+
+    /* The calling thread runs the first shard. */
+    for (i = 1; ok && i < config->shards; ++i) {
+        if (pthread_create(&shards[i].thread, NULL, server_SHARD,
+                    &shards[i]) != 0) {
+            fprintf(stderr, "ERROR: Failed starting %d threads.\n",
+                    config->shards);
+            server_SIGNAL(SIGTERM);
+            ok = false;
+            break;
+        }
+        ++started;
+    }
+    if (shards != NULL && ok) {
+        printf("Serving on %s with %d threads.\n", config->path,
+                config->shards);
+        fflush(stdout);
+        server_SHARD(&shards[0]);
+    }
+    for (i = 1; i < started; ++i) {
+        pthread_join(shards[i].thread, NULL);
+    }
+
+    for (i = 0; shards != NULL && i < config->shards; ++i) {
+        while (shards[i].sessions != NULL) {
+            server_session_DESTROY(shards[i].sessions);
+        }
+        if (shards[i].epoll > 0) {
+            close(shards[i].epoll);
+        }
+    }
+    free(shards);
+
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+    server_stop_fd = -1;
+    close(server.stop_fd);
+    close(server.listen_fd);
+    unlink(config->path);
+    return ok;
+}
+
+/*
+ * Client.
+ * =======
+ */
+
+/* Writes a whole buffer, retrying short writes. */
+static bool server_WRITE_ALL(int fd, const char *buffer, size_t length)
+{
+    ssize_t written;
+
+    while (length > 0) {
+        written = fd == STDOUT_FILENO ? write(fd, buffer, length) :
+                  send(fd, buffer, length, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        buffer += written;
+        length -= written;
+    }
+    return true;
+}
+
+bool server_client(const char *path)
+{
+    struct sockaddr_un address;
+    struct pollfd fds[2];
+    char buffer[4096];
+    ssize_t length;
+    int fd;
+    bool input = true;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "ERROR: Socket path %s is too long.\n", path);
+        return false;
+    }
+    strcpy(address.sun_path, path);
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0 ||
+        connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+            fprintf(stderr, "ERROR: Failed connecting to %s.\n", path);
+            if (fd >= 0) {
+                close(fd);
+            }
+            return false;
+    }
+
+    fds[0].fd = fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = STDIN_FILENO;
+    fds[1].events = POLLIN;
+
+    /* After the end of the input the replies are read until the server
+     * closes the session. */
+    for (;;) {
+        if (poll(fds, input ? 2 : 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[0].revents) {
+            length = recv(fd, buffer, sizeof(buffer), 0);
+            if (length <= 0 ||
+                !server_WRITE_ALL(STDOUT_FILENO, buffer, length)) {
+                    break;
+            }
+        }
+        if (input && fds[1].revents) {
+            length = read(STDIN_FILENO, buffer, sizeof(buffer));
+            if (length <= 0) {
+                shutdown(fd, SHUT_WR);
+                input = false;
+            } else if (!server_WRITE_ALL(fd, buffer, length)) {
+                break;
+            }
+        }
+    }
+
+    close(fd);
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "data.h"
+#include "game.h"
+
+/*
+ * Matches hosted for clients of a Unix domain socket. Every connection is
+ * a session playing its own game. The protocol is line based, the client
+ * sends one command per line:
+ *
+ *   h, j, k, l   Move the player.
+ *   L ID         Fire the laser at the enemy with the given id.
+ *   A            Fire the laser at the nearest enemy in the line of fire.
+ *   t            List the enemies in the line of fire.
+ *   n            Start a new match.
+ *   q            Close the session.
+ *
+ * and the server answers each with zero or more "msg TEXT" lines followed
+ * by one line that ends the reply:
+ *
+ *   hello WIDTH HEIGHT ENEMIES   On connecting and after n.
+ *   state TURN X Y ENEMIES RESULT  After a turn, RESULT being one of
+ *                                play, won or lost.
+ *   targets [ID...]              After t.
+ *   error TEXT                   After an invalid command.
+ *   bye                          After q.
+ */
+
+struct ServerConfig {
+    const char *path;
+    /* Threads, each with its own event loop and share of the sessions. */
+    int shards;
+    struct DataConfig data;
+    /* Settings of the session games, their workers are not used. */
+    struct GameConfig game;
+    uint64_t seed;
+};
+
+/** @brief Serves matches until SIGINT or SIGTERM, then closes all the
+  *        sessions and removes the socket.
+  * @return False if the server could not be started.
+  */
+bool server_run(const struct ServerConfig *config);
+
+/** @brief Connects the standard input and output to a server, sending the
+  *        input lines as commands and printing the replies until the
+  *        server closes the session.
+  * @return False if the connection failed.
+  */
+bool server_client(const char *path);
+
+#endif
@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "data.h"
+#include "scan.h"
+#include "sight.h"
+
+/* The index is rebuilt from scratch when it holds this many stale nodes
+ * per field, so that it stays bounded while the player stands still. */
+#define SIGHT_NODES_PER_FIELD 4
+#define SIGHT_NODES_INITIAL 1024
+
+struct SightLine {
+    int cell;
+    int length;
+    unsigned epoch;
+    unsigned generation;
+    bool sees;
+    bool valid;
+    bool pending;
+};
+
+/* Entry of a field's list of the lines walking through it. Entries of
+ * lines scanned again since are recognized by their old generation. */
+struct SightNode {
+    int line;
+    unsigned generation;
+    int next;
+};
+
+struct Sight {
+    int width, height;
+    int player_cell;
+    unsigned epoch;
+
+    struct SightLine *lines;
+    int lines_capacity;
+
+    int *heads;
+    unsigned *head_epochs;
+
+    struct SightNode *nodes;
+    size_t nodes_count;
+    size_t nodes_capacity;
+};
+
+struct Sight *sight_create(int width, int height)
+{
+    const size_t size = (size_t)width * height;
+    struct Sight *s = data_alloc(sizeof(*s));
+
+    s->width = width;
+    s->height = height;
+    s->player_cell = -1;
+    s->epoch = 1;
+    s->lines = NULL;
+    s->lines_capacity = 0;
+    s->heads = data_alloc(size * sizeof(*s->heads));
+    s->head_epochs = data_alloc(size * sizeof(*s->head_epochs));
+    memset(s->head_epochs, 0, size * sizeof(*s->head_epochs));
+    s->nodes_capacity = SIGHT_NODES_INITIAL;
+    s->nodes_count = 0;
+    s->nodes = malloc(s->nodes_capacity * sizeof(*s->nodes));
+    if (!s->nodes) {
+        fprintf(stderr, "ERROR: Failed allocating the sight index.\n");
+        exit(1);
+    }
+
+    return s;
+}
+
+void sight_destroy(struct Sight *s)
+{
+    if (s == NULL) {
+        return;
+    }
+    free(s->lines);
+    free(s->heads);
+    free(s->head_epochs);
+    free(s->nodes);
+    free(s);
+}
+
+/* Drops all the cached lines and the whole index in O(1). */
+static void sight_CLEAR(struct Sight *s)
+{
+    int i;
+
+    s->nodes_count = 0;
+    if (++s->epoch == 0) {
+        memset(s->head_epochs, 0,
+                (size_t)s->width * s->height * sizeof(*s->head_epochs));
+        for (i = 0; i < s->lines_capacity; ++i) {
+            s->lines[i].epoch = 0;
+        }
+        s->epoch = 1;
+    }
+}
+
+void sight_begin(struct Sight *s, const struct Data *d)
+{
+    const int player_cell = d->player.y * d->width + d->player.x;
+    int capacity;
+
+    if (d->enemy_ids_count > s->lines_capacity) {
+        capacity = d->enemy_ids_count > 2 * s->lines_capacity ?
+            d->enemy_ids_count : 2 * s->lines_capacity;
+        s->lines = realloc(s->lines, capacity * sizeof(*s->lines));
+        if (!s->lines) {
+            fprintf(stderr, "ERROR: Failed growing the sight cache.\n");
+            exit(1);
+        }
+        memset(s->lines + s->lines_capacity, 0,
+                (capacity - s->lines_capacity) * sizeof(*s->lines));
+        s->lines_capacity = capacity;
+    }
+
+    if (player_cell != s->player_cell || s->nodes_count >
+            (size_t)SIGHT_NODES_PER_FIELD * s->width * s->height) {
+        s->player_cell = player_cell;
+        sight_CLEAR(s);
+    }
+}
+
+int sight_lookup(const struct Sight *s, int id, int cell)
+{
+    const struct SightLine *l = &s->lines[id];
+    if (l->epoch != s->epoch || !l->valid || l->cell != cell) {
+        return -1;
+    }
+    return l->sees;
+}
+
+bool sight_compute(struct Sight *s, const struct Data *d, int id, int cell)
+{
+    struct SightLine *l = &s->lines[id];
+    struct ScanLine line;
+    int length = 0, next;
+    bool sees = false;
+
+    scan_line_init(&line, cell % d->width, cell / d->width,
+            d->player.x, d->player.y);
+    while (scan_line_next(&line)) {
+        ++length;
+        next = line.y * d->width + line.x;
+        if (data_plane_get(d->blocked, next) ||
+            data_plane_get(d->occupied, next)) {
+            break;
+        }
+        if (next == s->player_cell) {
+            sees = true;
+            break;
+        }
+    }
+
+    l->cell = cell;
+    l->length = length;
+    l->epoch = s->epoch;
+    ++l->generation;
+    l->sees = sees;
+    l->valid = true;
+    l->pending = true;
+    return sees;
+}
+
+static void sight_INDEX(struct Sight *s, int id, int cell)
+{
+    struct SightNode *node;
+
+    if (s->head_epochs[cell] != s->epoch) {
+        s->head_epochs[cell] = s->epoch;
+        s->heads[cell] = -1;
+    }
+    if (s->nodes_count == s->nodes_capacity) {
+        s->nodes_capacity *= 2;
+        s->nodes = realloc(s->nodes, s->nodes_capacity * sizeof(*s->nodes));
+        if (!s->nodes) {
+            fprintf(stderr, "ERROR: Failed growing the sight index.\n");
+            exit(1);
+        }
+    }
+
+    node = &s->nodes[s->nodes_count];
+    node->line = id;
+    node->generation = s->lines[id].generation;
+    node->next = s->heads[cell];
+    s->heads[cell] = s->nodes_count++;
+}
+
+void sight_commit(struct Sight *s, const struct Data *d)
+{
+    struct SightLine *l;
+    struct ScanLine line;
+    int i, id, length;
+
+    for (i = 0; i < d->enemies_count; ++i) {
+        id = d->enemies.id[i];
+        l = &s->lines[id];
+        if (!l->pending) {
+            continue;
+        }
+        l->pending = false;
+
+        scan_line_init(&line, l->cell % d->width, l->cell / d->width,
+                d->player.x, d->player.y);
+        for (length = 0; length < l->length && scan_line_next(&line); ++length) {
+            sight_INDEX(s, id, line.y * d->width + line.x);
+        }
+    }
+}
+
+void sight_touch(struct Sight *s, int cell)
+{
+    struct SightLine *l;
+    int n;
+
+    if (s->head_epochs[cell] != s->epoch) {
+        return;
+    }
+    for (n = s->heads[cell]; n != -1; n = s->nodes[n].next) {
+        l = &s->lines[s->nodes[n].line];
+        if (l->generation == s->nodes[n].generation) {
+            l->valid = false;
+        }
+    }
+    s->heads[cell] = -1;
+}
@@ -0,0 +1,48 @@
+#ifndef SIGHT_H
+#define SIGHT_H
+
+#include <stdbool.h>
+
+struct Data;
+
+/*
+ * Cache of the lines of sight from the enemies to the player, keyed by
+ * the enemy id, the enemy field and the player field. Every cached line
+ * is indexed by the fields it walked, up to and including the field that
+ * stopped it, so an entity entering or leaving one of those fields drops
+ * exactly the lines it may have changed. A move of the player drops all
+ * the lines at once.
+ */
+struct Sight;
+
+struct Sight *sight_create(int width, int height);
+void sight_destroy(struct Sight *s);
+
+/** @brief Prepares the cache for the lookups of a turn. Must be called
+  *        serially before sight_lookup and sight_compute.
+  */
+void sight_begin(struct Sight *s, const struct Data *d);
+
+/** @brief Looks up the cached line of sight of an enemy.
+  * @return 1 if the enemy sees the player, 0 if it does not, -1 if the
+  *         line is not cached.
+  */
+int sight_lookup(const struct Sight *s, int id, int cell);
+
+/** @brief Scans the line of sight of an enemy and caches the result. Calls
+  *        for different enemies may run concurrently.
+  * @return True if the enemy sees the player.
+  */
+bool sight_compute(struct Sight *s, const struct Data *d, int id, int cell);
+
+/** @brief Indexes the lines scanned since the last call, so that
+  *        sight_touch can find them. Must be called serially.
+  */
+void sight_commit(struct Sight *s, const struct Data *d);
+
+/** @brief Drops the cached lines passing through a field whose content
+  *        changed.
+  */
+void sight_touch(struct Sight *s, int cell);
+
+#endif
@@ -0,0 +1,409 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "snapshot.h"
+
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+#define SNAPSHOT_ALIGN(MACRO_size) (((MACRO_size) + 7) & ~(uint64_t)7)
+
+_Static_assert(sizeof(int) == sizeof(int32_t),
+        "Snapshots store the int fields as 32-bit integers.");
+
+/* Sizes of the sections in bytes, given the counts in a header. */
+static void snapshot_SIZES(const struct SnapshotHeader *h, uint64_t *sizes)
+{
+    const uint64_t cells = (uint64_t)h->width * h->height;
+    const uint64_t enemies = (uint64_t)h->enemies_count * sizeof(int32_t);
+
+    sizes[SS_ASTEROIDS] = (uint64_t)h->asteroids_count * 4 * sizeof(int32_t);
+    sizes[SS_ENEMY_X] = enemies;
+    sizes[SS_ENEMY_Y] = enemies;
+    sizes[SS_ENEMY_BEHAVIOR] = enemies;
+    sizes[SS_ENEMY_ID] = enemies;
+    sizes[SS_ENEMY_PATH_OFFSET] = enemies;
+    sizes[SS_ENEMY_PATH_LENGTH] = enemies;
+    sizes[SS_ENEMY_PATH_STEP] = enemies;
+    sizes[SS_ENEMY_PATH_DRIFT] = enemies;
+    sizes[SS_PATHS] = (uint64_t)h->paths_length * sizeof(int32_t);
+    sizes[SS_EXPLORED] = (cells + 63) / 64 * sizeof(uint64_t);
+    sizes[SS_BLOCKED] = (cells + 63) / 64 * sizeof(uint64_t);
+    sizes[SS_TERRAIN] = cells * sizeof(uint8_t);
+}
+
+static void snapshot_CONFIG(const struct SnapshotHeader *h,
+        struct DataConfig *config)
+{
+    config->width = h->width;
+    config->height = h->height;
+    config->asteroids_min = h->asteroids_min;
+    config->asteroids_max = h->asteroids_max;
+    config->asteroid_side_min = h->asteroid_side_min;
+    config->asteroid_side_max = h->asteroid_side_max;
+    config->enemies_min = h->enemies_min;
+    config->enemies_max = h->enemies_max;
+    config->nebulae_min = h->nebulae_min;
+    config->nebulae_max = h->nebulae_max;
+    config->margin_cost = h->margin_cost;
+    config->paths_mode = h->paths_mode;
+}
+
+bool snapshot_save(const struct Data *d, const char *path)
+{
+    struct SnapshotHeader h;
+    uint64_t sizes[SS_COUNT], offset;
+    int32_t *section;
+    char *image;
+    FILE *file;
+    int i, paths_length = 0;
+    bool ok;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = SNAPSHOT_VERSION;
+    h.byte_order = SNAPSHOT_BYTE_ORDER;
+
+    h.width = d->config.width;
+    h.height = d->config.height;
+    h.asteroids_min = d->config.asteroids_min;
+    h.asteroids_max = d->config.asteroids_max;
+    h.asteroid_side_min = d->config.asteroid_side_min;
+    h.asteroid_side_max = d->config.asteroid_side_max;
+    h.enemies_min = d->config.enemies_min;
+    h.enemies_max = d->config.enemies_max;
+    h.nebulae_min = d->config.nebulae_min;
+    h.nebulae_max = d->config.nebulae_max;
+    h.margin_cost = d->config.margin_cost;
+    h.paths_mode = d->config.paths_mode;
+
+    for (i = 0; i < d->enemies_count; ++i) {
+        paths_length += d->enemies.hunt_path_length[i];
+    }
+    h.asteroids_count = d->asteroids_count;
+    h.enemies_count = d->enemies_count;
+    h.enemy_ids_count = d->enemy_ids_count;
+    h.paths_length = paths_length;
+
+    h.player_x = d->player.x;
+    h.player_y = d->player.y;
+    h.player_health = d->player.health;
+    memcpy(h.rng, d->rng.s, sizeof(h.rng));
+
+    snapshot_SIZES(&h, sizes);
+    offset = SNAPSHOT_ALIGN(sizeof(h));
+    for (i = 0; i < SS_COUNT; ++i) {
+        h.offsets[i] = offset;
+        offset = SNAPSHOT_ALIGN(offset + sizes[i]);
+    }
+    h.file_size = offset;
+
+    image = calloc(1, h.file_size);
+    if (!image) {
+        fprintf(stderr, "ERROR: Failed allocating the snapshot.\n");
+        return false;
+    }
+    memcpy(image, &h, sizeof(h));
+
+/* Empty sections may come from arrays that were never allocated. */
+#define SNAPSHOT_COPY(MACRO_section, MACRO_source)\
+    if (sizes[MACRO_section] > 0) {\
+        memcpy(image + h.offsets[MACRO_section], (MACRO_source),\
+                sizes[MACRO_section]);\
+    }
+
+    SNAPSHOT_COPY(SS_ASTEROIDS, d->asteroids);
+    SNAPSHOT_COPY(SS_ENEMY_X, d->enemies.x);
+    SNAPSHOT_COPY(SS_ENEMY_Y, d->enemies.y);
+    SNAPSHOT_COPY(SS_ENEMY_ID, d->enemies.id);
+    SNAPSHOT_COPY(SS_ENEMY_PATH_LENGTH, d->enemies.hunt_path_length);
+    SNAPSHOT_COPY(SS_ENEMY_PATH_STEP, d->enemies.hunt_path_step);
+    SNAPSHOT_COPY(SS_ENEMY_PATH_DRIFT, d->enemies.hunt_path_drift);
+    SNAPSHOT_COPY(SS_EXPLORED, d->explored);
+    SNAPSHOT_COPY(SS_BLOCKED, d->blocked);
+    SNAPSHOT_COPY(SS_TERRAIN, d->terrain);
+
+#undef SNAPSHOT_COPY
+
+    section = (int32_t *)(image + h.offsets[SS_ENEMY_BEHAVIOR]);
+    for (i = 0; i < d->enemies_count; ++i) {
+        section[i] = d->enemies.behavior[i];
+    }
+
+    paths_length = 0;
+    section = (int32_t *)(image + h.offsets[SS_ENEMY_PATH_OFFSET]);
+    for (i = 0; i < d->enemies_count; ++i) {
+        section[i] = paths_length;
+        if (d->enemies.hunt_path_length[i] > 0) {
+            memcpy(image + h.offsets[SS_PATHS] +
+                    paths_length * sizeof(int32_t),
+                    d->enemies.hunt_path[i],
+                    d->enemies.hunt_path_length[i] * sizeof(int32_t));
+        }
+        paths_length += d->enemies.hunt_path_length[i];
+    }
+
+    if ((file = fopen(path, "wb")) == NULL) {
+        fprintf(stderr, "ERROR: Failed opening snapshot %s.\n", path);
+        free(image);
+        return false;
+    }
+    ok = fwrite(image, h.file_size, 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        fprintf(stderr, "ERROR: Failed writing snapshot %s.\n", path);
+    }
+    free(image);
+    return ok;
+}
+
+/* Checks that no two enemies share an id or a field, and that no enemy
+ * sits on an asteroid or on the player, which the enemy index, the enemy
+ * map and the free field list built from them rely on. */
+static const char *snapshot_CHECK_PLACES(const struct Snapshot *s)
+{
+    const struct SnapshotHeader *h = s->header;
+    const int cells = h->width * h->height;
+    const char *error = NULL;
+    uint64_t *taken, *ids;
+    int i, cell;
+
+    taken = calloc((cells + 63) / 64, sizeof(*taken));
+    ids = calloc((h->enemy_ids_count + 63) / 64 + 1, sizeof(*ids));
+    if (taken == NULL || ids == NULL) {
+        free(taken);
+        free(ids);
+        return "Failed allocating the snapshot check.";
+    }
+
+    data_plane_set(taken, h->player_y * h->width + h->player_x);
+    for (i = 0; i < h->enemies_count && error == NULL; ++i) {
+        cell = s->enemy_y[i] * h->width + s->enemy_x[i];
+        if (data_plane_get(s->blocked, cell) || data_plane_get(taken, cell) ||
+            data_plane_get(ids, s->enemy_id[i])) {
+            error = "Invalid snapshot enemy.";
+        }
+        data_plane_set(taken, cell);
+        data_plane_set(ids, s->enemy_id[i]);
+    }
+
+    free(taken);
+    free(ids);
+    return error;
+}
+
+/* Checks everything snapshot_restore relies on. */
+static const char *snapshot_CHECK(const struct Snapshot *s)
+{
+    const struct SnapshotHeader *h = s->header;
+    struct DataConfig config;
+    uint64_t sizes[SS_COUNT];
+    int i, j, cells;
+
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0) {
+        return "Not a snapshot.";
+    }
+    if (h->version != SNAPSHOT_VERSION) {
+        return "Unsupported snapshot version.";
+    }
+    if (h->byte_order != SNAPSHOT_BYTE_ORDER) {
+        return "Snapshot written with a different byte order.";
+    }
+    if (h->file_size > s->size) {
+        return "Truncated snapshot.";
+    }
+
+    snapshot_CONFIG(h, &config);
+    if (data_config_check(&config) != NULL ||
+        (h->paths_mode != POOL_KEEP && h->paths_mode != POOL_TURN)) {
+        return "Invalid snapshot configuration.";
+    }
+    cells = h->width * h->height;
+    if (h->asteroids_count < 0 || h->asteroids_count > h->asteroids_max ||
+        h->enemies_count < 0 || h->enemies_count > h->enemy_ids_count ||
+        h->paths_length < 0) {
+        return "Invalid snapshot counts.";
+    }
+
+    snapshot_SIZES(h, sizes);
+    for (i = 0; i < SS_COUNT; ++i) {
+        if (h->offsets[i] % 8 != 0 || h->offsets[i] > h->file_size ||
+            sizes[i] > h->file_size - h->offsets[i]) {
+            return "Invalid snapshot section.";
+        }
+    }
+
+    if (h->player_x < 0 || h->player_x >= h->width ||
+        h->player_y < 0 || h->player_y >= h->height ||
+        data_plane_get(s->blocked, h->player_y * h->width + h->player_x)) {
+        return "Invalid snapshot player.";
+    }
+    for (i = 0; i < h->asteroids_count; ++i) {
+        const int32_t *a = s->asteroids + 4 * i;
+        if (a[0] < 0 || a[0] > a[2] || a[2] >= h->width ||
+            a[1] < 0 || a[1] > a[3] || a[3] >= h->height) {
+            return "Invalid snapshot asteroid.";
+        }
+    }
+    for (i = 0; i < cells; ++i) {
+        if (s->terrain[i] < 1 || s->terrain[i] > TERRAIN_COST_MAX) {
+            return "Invalid snapshot terrain.";
+        }
+    }
+    for (i = 0; i < h->enemies_count; ++i) {
+        if (s->enemy_x[i] < 0 || s->enemy_x[i] >= h->width ||
+            s->enemy_y[i] < 0 || s->enemy_y[i] >= h->height ||
+            s->enemy_id[i] < 0 || s->enemy_id[i] >= h->enemy_ids_count ||
+            (s->enemy_behavior[i] != EB_IDLE &&
+             s->enemy_behavior[i] != EB_HUNT)) {
+            return "Invalid snapshot enemy.";
+        }
+        /* A stored path always has its next step left to take. */
+        if (s->enemy_path_offset[i] < 0 || s->enemy_path_length[i] < 0 ||
+            s->enemy_path_length[i] >
+                h->paths_length - s->enemy_path_offset[i] ||
+            s->enemy_path_step[i] < 0 ||
+            s->enemy_path_step[i] > s->enemy_path_length[i] ||
+            (s->enemy_path_length[i] > 0 &&
+             s->enemy_path_step[i] == s->enemy_path_length[i]) ||
+            s->enemy_path_drift[i] < 0) {
+            return "Invalid snapshot hunt path.";
+        }
+        for (j = 0; j < s->enemy_path_length[i]; ++j) {
+            const int32_t cell = s->paths[s->enemy_path_offset[i] + j];
+            if (cell < 0 || cell >= cells) {
+                return "Invalid snapshot hunt path.";
+            }
+        }
+    }
+
+    return snapshot_CHECK_PLACES(s);
+}
+
+bool snapshot_open(struct Snapshot *s, const char *path)
+{
+    struct stat st;
+    const char *base, *error;
+    int fd;
+
+    memset(s, 0, sizeof(*s));
+
+    if ((fd = open(path, O_RDONLY)) == -1) {
+        fprintf(stderr, "ERROR: Failed opening snapshot %s.\n", path);
+        return false;
+    }
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(*s->header)) {
+        fprintf(stderr, "ERROR: Invalid snapshot %s.\n", path);
+        close(fd);
+        return false;
+    }
+    s->size = st.st_size;
+    s->mapping = mmap(NULL, s->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (s->mapping == MAP_FAILED) {
+        fprintf(stderr, "ERROR: Failed mapping snapshot %s.\n", path);
+        s->mapping = NULL;
+        return false;
+    }
+
+    base = s->mapping;
+    s->header = s->mapping;
+    if (s->header->file_size <= s->size) {
+        s->asteroids = (const int32_t *)(base + s->header->offsets[SS_ASTEROIDS]);
+        s->enemy_x = (const int32_t *)(base + s->header->offsets[SS_ENEMY_X]);
+        s->enemy_y = (const int32_t *)(base + s->header->offsets[SS_ENEMY_Y]);
+        s->enemy_behavior =
+            (const int32_t *)(base + s->header->offsets[SS_ENEMY_BEHAVIOR]);
+        s->enemy_id = (const int32_t *)(base + s->header->offsets[SS_ENEMY_ID]);
+        s->enemy_path_offset =
+            (const int32_t *)(base + s->header->offsets[SS_ENEMY_PATH_OFFSET]);
+        s->enemy_path_length =
+            (const int32_t *)(base + s->header->offsets[SS_ENEMY_PATH_LENGTH]);
+        s->enemy_path_step =
+            (const int32_t *)(base + s->header->offsets[SS_ENEMY_PATH_STEP]);
+        s->enemy_path_drift =
+            (const int32_t *)(base + s->header->offsets[SS_ENEMY_PATH_DRIFT]);
+        s->paths = (const int32_t *)(base + s->header->offsets[SS_PATHS]);
+        s->explored = (const uint64_t *)(base + s->header->offsets[SS_EXPLORED]);
+        s->blocked = (const uint64_t *)(base + s->header->offsets[SS_BLOCKED]);
+        s->terrain = (const uint8_t *)(base + s->header->offsets[SS_TERRAIN]);
+    }
+
+    if ((error = snapshot_CHECK(s)) != NULL) {
+        fprintf(stderr, "ERROR: %s (%s)\n", error, path);
+        snapshot_close(s);
+        return false;
+    }
+    return true;
+}
+
+void snapshot_close(struct Snapshot *s)
+{
+    if (s->mapping != NULL) {
+        munmap(s->mapping, s->size);
+    }
+    memset(s, 0, sizeof(*s));
+}
+
+void snapshot_restore(const struct Snapshot *s, struct Data *d)
+{
+    const struct SnapshotHeader *h = s->header;
+    struct DataConfig config;
+    int i, length;
+    int *path;
+
+    snapshot_CONFIG(h, &config);
+    data_init_map(d, &config);
+    memcpy(d->rng.s, h->rng, sizeof(d->rng.s));
+
+    if (h->asteroids_count > 0) {
+        memcpy(d->asteroids, s->asteroids,
+                h->asteroids_count * sizeof(*d->asteroids));
+    }
+    d->asteroids_count = h->asteroids_count;
+    memcpy(d->explored, s->explored, data_plane_words(d) * sizeof(*d->explored));
+    memcpy(d->blocked, s->blocked, data_plane_words(d) * sizeof(*d->blocked));
+    memcpy(d->terrain, s->terrain, (size_t)d->width * d->height);
+    for (i = 0; i < d->width * d->height; ++i) {
+        if (d->terrain[i] > d->terrain_max) {
+            d->terrain_max = d->terrain[i];
+        }
+    }
+
+    data_enemies_reserve(d, h->enemies_count, h->enemy_ids_count);
+    d->enemy_ids_count = h->enemy_ids_count;
+    for (i = 0; i < h->enemy_ids_count; ++i) {
+        d->enemy_index[i] = -1;
+    }
+
+    for (i = 0; i < h->enemies_count; ++i) {
+        d->enemies.x[i] = s->enemy_x[i];
+        d->enemies.y[i] = s->enemy_y[i];
+        d->enemies.behavior[i] = s->enemy_behavior[i];
+        d->enemies.id[i] = s->enemy_id[i];
+
+        path = NULL;
+        if ((length = s->enemy_path_length[i]) > 0) {
+            path = pool_alloc(d->paths, length);
+            memcpy(path, s->paths + s->enemy_path_offset[i],
+                    length * sizeof(*path));
+        }
+        d->enemies.hunt_path[i] = path;
+        d->enemies.hunt_path_length[i] = length;
+        d->enemies.hunt_path_step[i] = s->enemy_path_step[i];
+        d->enemies.hunt_path_drift[i] = s->enemy_path_drift[i];
+
+        d->enemy_map[s->enemy_y[i] * d->width + s->enemy_x[i]] = i;
+        data_plane_set(d->occupied, s->enemy_y[i] * d->width + s->enemy_x[i]);
+        d->enemy_index[s->enemy_id[i]] = i;
+    }
+    d->enemies_count = h->enemies_count;
+    data_index_free_cells(d);
+
+    d->player.x = h->player_x;
+    d->player.y = h->player_y;
+    d->player.health = h->player_health;
+}
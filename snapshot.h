@@ -0,0 +1,107 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "data.h"
+
+#define SNAPSHOT_MAGIC "STBSNAP"
+#define SNAPSHOT_VERSION 4
+
+/*
+ * Snapshot file layout.
+ * =====================
+ *
+ * A header followed by sections of native 32-bit integers, each starting
+ * at an 8-byte aligned offset given in the header. The enemies are stored
+ * as parallel arrays like in struct Data, their hunt paths concatenated
+ * in the paths section. The explored and blocked bit planes follow, then
+ * the terrain with one byte per field, so a mapped snapshot can be read
+ * in place.
+ */
+
+enum snapshot_section {
+    SS_ASTEROIDS,
+    SS_ENEMY_X,
+    SS_ENEMY_Y,
+    SS_ENEMY_BEHAVIOR,
+    SS_ENEMY_ID,
+    SS_ENEMY_PATH_OFFSET,
+    SS_ENEMY_PATH_LENGTH,
+    SS_ENEMY_PATH_STEP,
+    SS_ENEMY_PATH_DRIFT,
+    SS_PATHS,
+    SS_EXPLORED,
+    SS_BLOCKED,
+    SS_TERRAIN,
+    SS_COUNT
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+
+    int32_t width, height;
+    int32_t asteroids_min, asteroids_max;
+    int32_t asteroid_side_min, asteroid_side_max;
+    int32_t enemies_min, enemies_max;
+    int32_t nebulae_min, nebulae_max;
+    int32_t margin_cost;
+    int32_t paths_mode;
+
+    int32_t asteroids_count;
+    int32_t enemies_count;
+    int32_t enemy_ids_count;
+    int32_t paths_length;
+
+    int32_t player_x, player_y;
+    double player_health;
+
+    uint64_t rng[4];
+
+    uint64_t offsets[SS_COUNT];
+};
+
+/** @brief A snapshot file mapped into memory. The pointers point into the
+  *        mapping and stay valid until snapshot_close.
+  */
+struct Snapshot {
+    void *mapping;
+    size_t size;
+
+    const struct SnapshotHeader *header;
+    const int32_t *asteroids;
+    const int32_t *enemy_x, *enemy_y;
+    const int32_t *enemy_behavior;
+    const int32_t *enemy_id;
+    const int32_t *enemy_path_offset;
+    const int32_t *enemy_path_length;
+    const int32_t *enemy_path_step;
+    const int32_t *enemy_path_drift;
+    const int32_t *paths;
+    const uint64_t *explored;
+    const uint64_t *blocked;
+    const uint8_t *terrain;
+};
+
+/** @brief Writes the whole game state into a snapshot file.
+  * @return True on success, false otherwise.
+  */
+bool snapshot_save(const struct Data *d, const char *path);
+
+/** @brief Maps a snapshot file and checks that it is consistent, without
+  *        copying anything.
+  * @return True on success, false otherwise.
+  */
+bool snapshot_open(struct Snapshot *s, const char *path);
+void snapshot_close(struct Snapshot *s);
+
+/** @brief Initializes the data with the state of an open snapshot, in
+  *        place of data_init_map and the other initialization functions.
+  */
+void snapshot_restore(const struct Snapshot *s, struct Data *d);
+
+#endif
@@ -0,0 +1,153 @@
+#include <stdbool.h>
+#include <signal.h>
+#include <time.h>
+
+#include "stats.h"
+
+/* Log-linear histogram buckets: exact below 8 ns, then 8 buckets for
+ * every power of two, i.e. within 12.5% of the measured value. */
+#define STATS_SUB_BITS 3
+#define STATS_BUCKETS (64 << STATS_SUB_BITS)
+
+uint64_t stats_counters[SC_COUNT];
+
+static const char *const stats_counter_names[SC_COUNT] = {
+    "scan_calls",
+    "scan_cells",
+    "scan_callbacks",
+    "path_pops",
+    "path_relaxes",
+    "render_bytes",
+    "sight_hits",
+    "sight_misses"
+};
+
+static const char *const stats_timer_names[ST_COUNT] = {
+    "plot_fog",
+    "plot_map",
+    "render",
+    "enemy_turns"
+};
+
+static struct {
+    uint64_t total[ST_COUNT];
+    uint64_t runs[ST_COUNT];
+} stats_timers;
+
+static struct {
+    uint64_t buckets[STATS_BUCKETS];
+    uint64_t count;
+    uint64_t max;
+} stats_turns;
+
+static volatile sig_atomic_t stats_requested;
+
+uint64_t stats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+void stats_time(enum stats_timer timer, uint64_t ns)
+{
+    __atomic_fetch_add(&stats_timers.total[timer], ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats_timers.runs[timer], 1, __ATOMIC_RELAXED);
+}
+
+static int stats_BUCKET(uint64_t ns)
+{
+    int msb;
+    if (ns < (1u << STATS_SUB_BITS)) {
+        return ns;
+    }
+    msb = 63 - __builtin_clzll(ns);
+    return ((msb - STATS_SUB_BITS + 1) << STATS_SUB_BITS) +
+           ((ns >> (msb - STATS_SUB_BITS)) & ((1u << STATS_SUB_BITS) - 1));
+}
+
+/* The smallest value falling into a bucket. */
+static uint64_t stats_BUCKET_MIN(int bucket)
+{
+    const int shift = (bucket >> STATS_SUB_BITS) - 1;
+    const uint64_t sub = bucket & ((1u << STATS_SUB_BITS) - 1);
+    if (shift < 0) {
+        return bucket;
+    }
+    return ((1u << STATS_SUB_BITS) + sub) << shift;
+}
+
+/* Batch matches account their turns from several threads at once. */
+void stats_turn(uint64_t ns)
+{
+    uint64_t max = __atomic_load_n(&stats_turns.max, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&stats_turns.buckets[stats_BUCKET(ns)], 1,
+            __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats_turns.count, 1, __ATOMIC_RELAXED);
+    while (ns > max && !__atomic_compare_exchange_n(&stats_turns.max, &max,
+                ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/* Upper bound of the turn latency below which the given share falls. */
+static uint64_t stats_PERCENTILE(double share)
+{
+    const uint64_t rank = (uint64_t)(share * stats_turns.count);
+    uint64_t seen = 0;
+    int i;
+
+    for (i = 0; i < STATS_BUCKETS - 1; ++i) {
+        seen += stats_turns.buckets[i];
+        if (seen > rank) {
+            break;
+        }
+    }
+    if (i == STATS_BUCKETS - 1 || stats_BUCKET_MIN(i + 1) > stats_turns.max) {
+        return stats_turns.max;
+    }
+    return stats_BUCKET_MIN(i + 1) - 1;
+}
+
+static void stats_SIGNAL(int sig)
+{
+    (void)sig;
+    stats_requested = 1;
+}
+
+void stats_init(void)
+{
+    signal(SIGUSR1, stats_SIGNAL);
+}
+
+void stats_poll(FILE *file)
+{
+    if (stats_requested) {
+        stats_requested = 0;
+        stats_report(file);
+    }
+}
+
+void stats_report(FILE *file)
+{
+    int i;
+
+    for (i = 0; i < SC_COUNT; ++i) {
+        fprintf(file, "counter %-16s %llu\n", stats_counter_names[i],
+                (unsigned long long)stats_counters[i]);
+    }
+    for (i = 0; i < ST_COUNT; ++i) {
+        fprintf(file, "timer   %-16s %llu runs %.3f ms total %.3f us/run\n",
+                stats_timer_names[i],
+                (unsigned long long)stats_timers.runs[i],
+                stats_timers.total[i] * 1e-6,
+                stats_timers.runs[i] ?
+                    stats_timers.total[i] * 1e-3 / stats_timers.runs[i] : 0.0);
+    }
+    fprintf(file, "turns   %llu p50 %.3f us p99 %.3f us max %.3f us\n",
+            (unsigned long long)stats_turns.count,
+            stats_PERCENTILE(0.50) * 1e-3,
+            stats_PERCENTILE(0.99) * 1e-3,
+            stats_turns.max * 1e-3);
+    fflush(file);
+}
@@ -0,0 +1,85 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Hot-path counters, timers and a per-turn latency histogram. They are
+ * only compiled in when building with STATS defined (make STATS=1),
+ * otherwise the STATS_* macros do nothing beyond evaluating the values
+ * passed to STATS_ADD.
+ */
+
+enum stats_counter {
+    SC_SCAN_CALLS,
+    SC_SCAN_CELLS,
+    SC_SCAN_CALLBACKS,
+    SC_PATH_POPS,
+    SC_PATH_RELAXES,
+    SC_RENDER_BYTES,
+    SC_SIGHT_HITS,
+    SC_SIGHT_MISSES,
+    SC_COUNT
+};
+
+enum stats_timer {
+    ST_PLOT_FOG,
+    ST_PLOT_MAP,
+    ST_RENDER,
+    ST_ENEMY_TURNS,
+    ST_COUNT
+};
+
+extern uint64_t stats_counters[SC_COUNT];
+
+/** @brief Returns a monotonic time in nanoseconds. */
+uint64_t stats_now(void);
+
+/** @brief Accounts one run of a timer. */
+void stats_time(enum stats_timer timer, uint64_t ns);
+
+/** @brief Adds the duration of one turn to the latency histogram. */
+void stats_turn(uint64_t ns);
+
+/** @brief Makes SIGUSR1 request a report at the next stats_poll. */
+void stats_init(void);
+
+/** @brief Prints the report if one was requested. */
+void stats_poll(FILE *file);
+
+/** @brief Prints all the counters, timers and turn latency percentiles. */
+void stats_report(FILE *file);
+
+#ifdef STATS
+
+static inline void stats_add(enum stats_counter counter, uint64_t value)
+{
+    __atomic_fetch_add(&stats_counters[counter], value, __ATOMIC_RELAXED);
+}
+
+#define STATS_ADD(MACRO_counter, MACRO_value)\
+    stats_add((MACRO_counter), (MACRO_value))
+#define STATS_START(MACRO_start)\
+    const uint64_t MACRO_start = stats_now()
+#define STATS_STOP(MACRO_timer, MACRO_start)\
+    stats_time((MACRO_timer), stats_now() - (MACRO_start))
+#define STATS_TURN(MACRO_start)\
+    stats_turn(stats_now() - (MACRO_start))
+#define STATS_INIT() stats_init()
+#define STATS_POLL(MACRO_file) stats_poll(MACRO_file)
+#define STATS_REPORT(MACRO_file) stats_report(MACRO_file)
+
+#else
+
+#define STATS_ADD(MACRO_counter, MACRO_value) ((void)(MACRO_value))
+#define STATS_START(MACRO_start) ((void)0)
+#define STATS_STOP(MACRO_timer, MACRO_start) ((void)0)
+#define STATS_TURN(MACRO_start) ((void)0)
+#define STATS_INIT() ((void)0)
+#define STATS_POLL(MACRO_file) ((void)0)
+#define STATS_REPORT(MACRO_file) ((void)0)
+
+#endif
+
+#endif
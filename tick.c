@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "tick.h"
+#include "stats.h"
+
+/* Tick costs are kept in steps of a thousandth of the budget, the last
+ * step holding everything from twice the budget up. */
+#define TICK_LOAD_STEPS 1000
+#define TICK_LOAD_BUCKETS (2 * TICK_LOAD_STEPS + 1)
+
+struct Ticker {
+    int fd;
+    int rate;
+    uint64_t budget;
+
+    uint64_t started, begun;
+    uint64_t ticks, late, caught_up, skipped;
+    uint64_t total, max;
+    uint64_t load[TICK_LOAD_BUCKETS];
+};
+
+struct Ticker *ticker_create(int rate)
+{
+    struct Ticker *t = calloc(1, sizeof(*t));
+    struct itimerspec period;
+
+    if (t == NULL) {
+        return NULL;
+    }
+    t->rate = rate;
+    t->budget = 1000000000u / rate;
+
+    t->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (t->fd < 0) {
+        free(t);
+        return NULL;
+    }
+    period.it_interval.tv_sec = t->budget / 1000000000u;
+    period.it_interval.tv_nsec = t->budget % 1000000000u;
+    period.it_value = period.it_interval;
+    if (timerfd_settime(t->fd, 0, &period, NULL) < 0) {
+        close(t->fd);
+        free(t);
+        return NULL;
+    }
+
+    t->started = stats_now();
+    return t;
+}
+
+void ticker_destroy(struct Ticker *t)
+{
+    if (t == NULL) {
+        return;
+    }
+    close(t->fd);
+    free(t);
+}
+
+int ticker_fd(const struct Ticker *t)
+{
+    return t->fd;
+}
+
+int ticker_due(struct Ticker *t, bool wait)
+{
+    struct pollfd pfd;
+    uint64_t expired;
+
+    pfd.fd = t->fd;
+    pfd.events = POLLIN;
+
+    for (;;) {
+        if (read(t->fd, &expired, sizeof(expired)) == sizeof(expired)) {
+            break;
+        }
+        if (errno != EAGAIN && errno != EINTR) {
+            return 0;
+        }
+        if (!wait) {
+            return 0;
+        }
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+            return 0;
+        }
+    }
+
+    if (expired > TICK_CATCHUP_MAX) {
+        t->skipped += expired - TICK_CATCHUP_MAX;
+        expired = TICK_CATCHUP_MAX;
+    }
+    t->caught_up += expired - 1;
+    return expired;
+}
+
+void ticker_begin(struct Ticker *t)
+{
+    t->begun = stats_now();
+}
+
+void ticker_end(struct Ticker *t)
+{
+    const uint64_t cost = stats_now() - t->begun;
+    uint64_t bucket = cost * TICK_LOAD_STEPS / t->budget;
+
+    if (bucket >= TICK_LOAD_BUCKETS) {
+        bucket = TICK_LOAD_BUCKETS - 1;
+    }
+    ++t->load[bucket];
+    ++t->ticks;
+    t->late += cost > t->budget;
+    t->total += cost;
+    if (cost > t->max) {
+        t->max = cost;
+    }
+}
+
+/* Upper bound of the tick cost below which the given share of ticks fall. */
+static uint64_t ticker_PERCENTILE(const struct Ticker *t, double share)
+{
+    const uint64_t rank = (uint64_t)(share * t->ticks);
+    uint64_t seen = 0;
+    int i;
+
+    for (i = 0; i < TICK_LOAD_BUCKETS - 1; ++i) {
+        seen += t->load[i];
+        if (seen > rank) {
+            break;
+        }
+    }
+    if (i == TICK_LOAD_BUCKETS - 1) {
+        return t->max;
+    }
+    return (i + 1) * t->budget / TICK_LOAD_STEPS < t->max ?
+           (i + 1) * t->budget / TICK_LOAD_STEPS : t->max;
+}
+
+void ticker_report(const struct Ticker *t, FILE *file)
+{
+    const double elapsed = (stats_now() - t->started) * 1e-9;
+
+    fprintf(file, "ticks %llu at %d Hz in %.3fs (%.1f Hz held) "
+            "budget %.3f us\n",
+            (unsigned long long)t->ticks, t->rate, elapsed,
+            elapsed > 0.0 ? t->ticks / elapsed : 0.0, t->budget * 1e-3);
+    fprintf(file, "tick cost mean %.3f us p50 %.3f us p99 %.3f us "
+            "max %.3f us\n",
+            t->ticks ? t->total * 1e-3 / t->ticks : 0.0,
+            ticker_PERCENTILE(t, 0.50) * 1e-3,
+            ticker_PERCENTILE(t, 0.99) * 1e-3, t->max * 1e-3);
+    fprintf(file, "ticks over budget %llu caught up %llu skipped %llu\n",
+            (unsigned long long)t->late, (unsigned long long)t->caught_up,
+            (unsigned long long)t->skipped);
+    fflush(file);
+}
@@ -0,0 +1,47 @@
+#ifndef TICK_H
+#define TICK_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/*
+ * Fixed-timestep clock for playing the enemy turns in real time. The
+ * ticks come from a timerfd, so a loop can wait for them together with
+ * its input. Ticks missed while a tick overran its budget are caught up
+ * back to back, up to TICK_CATCHUP_MAX of them, the rest are skipped so
+ * a slow engine falls behind the clock instead of piling up work.
+ */
+
+#define TICK_CATCHUP_MAX 4
+#define TICK_RATE_MAX 10000
+
+struct Ticker;
+
+/** @brief Starts a clock ticking rate times a second.
+  * @return The clock, NULL if the timer could not be created.
+  */
+struct Ticker *ticker_create(int rate);
+void ticker_destroy(struct Ticker *t);
+
+/** @brief Returns the descriptor that becomes readable when ticks are due. */
+int ticker_fd(const struct Ticker *t);
+
+/** @brief Takes the ticks that came due since the last call.
+  * @param t The clock.
+  * @param wait Whether to wait for the next tick if none is due yet.
+  * @return The number of ticks to play now, at most TICK_CATCHUP_MAX.
+  */
+int ticker_due(struct Ticker *t, bool wait);
+
+/** @brief Marks the start and the end of the work of one tick, whose cost
+  *        is accounted against the tick budget.
+  */
+void ticker_begin(struct Ticker *t);
+void ticker_end(struct Ticker *t);
+
+/** @brief Prints the tick rate that was held and the tick costs compared
+  *        to the budget.
+  */
+void ticker_report(const struct Ticker *t, FILE *file);
+
+#endif
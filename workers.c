@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "workers.h"
+
+struct Workers {
+    int count;
+    pthread_t *threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long generation;
+    int busy;
+    bool quit;
+
+    /* The current job, read-only while it runs. */
+    workers_func func;
+    void *context;
+    int items, chunk;
+    int next;
+};
+
+struct WorkersThread {
+    struct Workers *w;
+    int worker;
+};
+
+/* Takes chunks of the current job until there are none left. */
+static void workers_PROCESS(struct Workers *w, int worker)
+{
+    int begin, end;
+    for (;;) {
+        begin = __atomic_fetch_add(&w->next, w->chunk, __ATOMIC_RELAXED);
+        if (begin >= w->items) {
+            break;
+        }
+        end = begin + w->chunk < w->items ? begin + w->chunk : w->items;
+        w->func(w->context, worker, begin, end);
+    }
+}
+
+static void *workers_MAIN(void *arg)
+{
+    struct WorkersThread *t = arg;
+    struct Workers *w = t->w;
+    const int worker = t->worker;
+    unsigned long seen = 0;
+
+    free(t);
+
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->quit && w->generation == seen) {
+            pthread_cond_wait(&w->start, &w->lock);
+        }
+        if (w->quit) {
+            break;
+        }
+        seen = w->generation;
+        pthread_mutex_unlock(&w->lock);
+
+        workers_PROCESS(w, worker);
+
+        pthread_mutex_lock(&w->lock);
+        if (--w->busy == 0) {
+            pthread_cond_signal(&w->done);
+        }
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    return NULL;
+}
+
+struct Workers *workers_create(int count)
+{
+    struct Workers *w;
+    struct WorkersThread *t;
+
+    if (count < 1 || (w = calloc(1, sizeof(*w))) == NULL) {
+        return NULL;
+    }
+    if ((w->threads = calloc(count, sizeof(*w->threads))) == NULL) {
+        free(w);
+        return NULL;
+    }
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->start, NULL);
+    pthread_cond_init(&w->done, NULL);
+
+    for (w->count = 1; w->count < count; ++w->count) {
+        if ((t = malloc(sizeof(*t))) == NULL) {
+            break;
+        }
+        t->w = w;
+        t->worker = w->count;
+        if (pthread_create(&w->threads[w->count], NULL, workers_MAIN, t) != 0) {
+            free(t);
+            break;
+        }
+    }
+
+    if (w->count < count) {
+        workers_destroy(w);
+        return NULL;
+    }
+
+    return w;
+}
+
+void workers_destroy(struct Workers *w)
+{
+    int i;
+
+    if (w == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&w->lock);
+    w->quit = true;
+    pthread_cond_broadcast(&w->start);
+    pthread_mutex_unlock(&w->lock);
+
+    for (i = 1; i < w->count; ++i) {
+        pthread_join(w->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&w->done);
+    pthread_cond_destroy(&w->start);
+    pthread_mutex_destroy(&w->lock);
+    free(w->threads);
+    free(w);
+}
+
+int workers_count(const struct Workers *w)
+{
+    return w->count;
+}
+
+void workers_run(
+        struct Workers *w,
+        int items, int chunk,
+        workers_func func, void *context)
+{
+    if (items <= 0) {
+        return;
+    }
+
+    if (w->count == 1 || items <= chunk) {
+        func(context, 0, 0, items);
+        return;
+    }
+
+    pthread_mutex_lock(&w->lock);
+    w->func = func;
+    w->context = context;
+    w->items = items;
+    w->chunk = chunk;
+    w->next = 0;
+    w->busy = w->count - 1;
+    ++w->generation;
+    pthread_cond_broadcast(&w->start);
+    pthread_mutex_unlock(&w->lock);
+
+    workers_PROCESS(w, 0);
+
+    pthread_mutex_lock(&w->lock);
+    while (w->busy > 0) {
+        pthread_cond_wait(&w->done, &w->lock);
+    }
+    pthread_mutex_unlock(&w->lock);
+}
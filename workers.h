@@ -0,0 +1,30 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+/** @brief Callback processing the items [begin, end) of a parallel job.
+  * @param context The job context.
+  * @param worker The index of the calling worker, in [0, count).
+  */
+typedef void (*workers_func)(void *context, int worker, int begin, int end);
+
+struct Workers;
+
+/** @brief Starts a pool of count workers. The calling thread acts as
+  *        worker 0, so count - 1 threads are spawned.
+  * @return The pool, NULL if the threads could not be started.
+  */
+struct Workers *workers_create(int count);
+void workers_destroy(struct Workers *w);
+
+/** @brief Returns the number of workers in the pool. */
+int workers_count(const struct Workers *w);
+
+/** @brief Processes items [0, items) in chunks of chunk items spread over
+  *        all the workers and waits until every chunk is done.
+  */
+void workers_run(
+        struct Workers *w,
+        int items, int chunk,
+        workers_func func, void *context);
+
+#endif
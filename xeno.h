@@ -1,7 +0,0 @@
-#ifndef XENO_H
-#define XENO_H
-
-int XENO_getch(void);
-int XENO_rand_range(unsigned min, unsigned max);
-
-#endif